@@ -0,0 +1,107 @@
+#pragma once
+
+// Counts every heap allocation of the program, so a loop that should allocate nothing can be checked by
+// reading the count before and after. Only compiled in when DUNGEON_COUNT_ALLOCATIONS is defined, since it
+// replaces the global operator new and delete and adds an atomic increment to every allocation. Each
+// program may then include this from one translation unit only, as it includes includer.hpp
+
+#ifdef DUNGEON_COUNT_ALLOCATIONS
+
+static const bool allocationsCounted = true;
+
+std::atomic<std::size_t> allocationCount(0);
+
+std::size_t getAllocationCount() { return allocationCount.load(std::memory_order_relaxed); }
+
+void* allocateCounted(std::size_t size, std::size_t alignment)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0) size = 1;
+
+#ifdef _WIN32
+	return alignment > alignof(std::max_align_t) ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return alignment > alignof(std::max_align_t) ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+#endif
+}
+
+// Kept out of line: inlined into a delete expression, GCC sees free() taking memory from operator new and warns
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void freeCounted(void* memory, std::size_t alignment)
+{
+#ifdef _WIN32
+	if (alignment > alignof(std::max_align_t)) {
+		_aligned_free(memory);
+		return;
+	}
+#else
+	(void)alignment;
+#endif
+	std::free(memory);
+}
+
+// Every form of new goes through allocateCounted and every form of delete through freeCounted, so the count
+// misses nothing and memory is always released the way it was taken
+
+void* operator new(std::size_t size)
+{
+	void* memory = allocateCounted(size, alignof(std::max_align_t));
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocateCounted(size, alignof(std::max_align_t)); }
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocateCounted(size, alignof(std::max_align_t)); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* memory = allocateCounted(size, std::size_t(alignment));
+	if (memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateCounted(size, std::size_t(alignment)); }
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateCounted(size, std::size_t(alignment)); }
+
+void operator delete(void* memory) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete[](void* memory) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete(void* memory, std::size_t) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete[](void* memory, std::size_t) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { freeCounted(memory, alignof(std::max_align_t)); }
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept { freeCounted(memory, std::size_t(alignment)); }
+
+#else
+
+static const bool allocationsCounted = false;
+
+std::size_t getAllocationCount() { return 0; }
+
+#endif
\ No newline at end of file
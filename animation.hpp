@@ -1,62 +1,142 @@
 #pragma once
 
-class Animation {
-private:
-    std::vector<sf::Texture> frames;
+// Frames of one animation and how they are played. Built once per animation and shared,
+// read-only, by every instance playing it
+struct AnimationClip {
+    std::vector<AtlasRegion> frames;
+    float frameDuration;
     bool loop;
+};
+
+// Where one instance is in its clip, and the sprite showing it
+struct AnimationState {
+    const AnimationClip* clip;
+    sf::Sprite* sprite;
+    float elapsedTime;
+    unsigned short currentFrame;
     bool isPlaying;
-    int current_frame;
-    int num_frames;
-    float frame_duration;
-    float elapsed_time;
+};
+
+// Owns the clips and the playback state of every animated sprite. The states sit in one array
+// advanced in a single pass per frame; a sprite is only touched when its frame changes.
+// Not thread safe, instances are created and updated on the main thread
+class AnimationSystem {
+private:
+    const TextureAtlas* atlas;
+
+    // std::map keeps the clips where they are while new ones are added
+    std::map<std::string, AnimationClip> clips;
+
+    std::vector<AnimationState> states;
+    std::vector<unsigned int> freeStates;
+
+    void applyFrame(const AnimationState& state) const
+    {
+        if (!state.clip->frames.empty()) atlas->apply(*state.sprite, state.clip->frames[state.currentFrame]);
+    }
 
 public:
-    Animation(float frameDuration, int numFrames, bool loop = true) : 
-        frame_duration(frameDuration), num_frames(numFrames), loop(loop), isPlaying(false), current_frame(0), elapsed_time(0.0f) {}
-    void addFrame(const sf::Texture& texture) { frames.push_back(texture); }
-    const sf::Texture& getCurrentFrame() const { return frames[current_frame]; }
-    void play() { isPlaying = true; }
-    void load(std::string path);
+    AnimationSystem(const TextureAtlas* _atlas) : atlas(_atlas) {}
+
+    AnimationSystem(const AnimationSystem&) = delete;
+    AnimationSystem& operator=(const AnimationSystem&) = delete;
+
+    const AnimationClip* getClip(const std::string& path, unsigned int numFrames, float frameDuration, bool loop = true);
+
+    // Stopped on the clip's first frame, which the sprite shows right away
+    unsigned int create(const AnimationClip* clip, sf::Sprite* sprite);
+    void destroy(unsigned int id);
+
+    // Switching clips starts the new one from its first frame, playing the current one again continues it
+    void play(unsigned int id, const AnimationClip* clip);
+    void play(unsigned int id) { states[id].isPlaying = true; }
+    void stop(unsigned int id);
+
+    // For owners that move their sprite, e.g. the enemy store filling a hole with its last enemy
+    void setSprite(unsigned int id, sf::Sprite* sprite) { states[id].sprite = sprite; }
+
+    const AtlasRegion& getCurrentFrame(unsigned int id) const { return states[id].clip->frames[states[id].currentFrame]; }
+
     void update(float deltaTime);
-    void stop();
+
+    std::size_t getInstanceCount() const { return states.size() - freeStates.size(); }
 };
 
-void Animation::load(std::string path)
+const AnimationClip* AnimationSystem::getClip(const std::string& path, unsigned int numFrames, float frameDuration, bool loop)
 {
-    // Load textures for animation
-    for (int i = 0; i < num_frames; i++)
-    {
-        sf::Texture texture;
-        texture.loadFromFile(path + std::to_string(i) + ".png");
-        frames.push_back(texture);
+    auto it = clips.find(getAssetKey(path));
+    if (it != clips.end()) return &it->second;
+
+    // Frames come from the atlas' frame table, missing frames stay empty as missing files used to
+    AnimationClip& clip = clips[getAssetKey(path)];
+    clip.frames = atlas->getAnimation(path);
+    clip.frames.resize(numFrames, AtlasRegion{ 0, sf::IntRect() });
+    clip.frameDuration = frameDuration;
+    clip.loop = loop;
+    return &clip;
+}
+
+unsigned int AnimationSystem::create(const AnimationClip* clip, sf::Sprite* sprite)
+{
+    unsigned int id = states.size();
+    if (!freeStates.empty()) {
+        id = freeStates.back();
+        freeStates.pop_back();
+    }
+    else states.push_back(AnimationState());
+
+    states[id] = { clip, sprite, 0.0f, 0, false };
+    applyFrame(states[id]);
+    return id;
+}
+
+void AnimationSystem::destroy(unsigned int id)
+{
+    states[id].clip = nullptr;
+    states[id].sprite = nullptr;
+    states[id].isPlaying = false;
+    freeStates.push_back(id);
+}
+
+void AnimationSystem::play(unsigned int id, const AnimationClip* clip)
+{
+    if (states[id].clip != clip) {
+        states[id].clip = clip;
+        stop(id);
     }
+    states[id].isPlaying = true;
 }
 
-void Animation::update(float deltaTime) 
+void AnimationSystem::stop(unsigned int id)
 {
-    // Update texture based on current frame calculated from elapsed time
-    if (!isPlaying) return;
-    elapsed_time += deltaTime;
+    // Stop and reset animation
+    AnimationState& state = states[id];
+    state.isPlaying = false;
+    state.currentFrame = 0;
+    state.elapsedTime = 0.0f;
+    applyFrame(state);
+}
 
-    if (elapsed_time >= frame_duration) 
+void AnimationSystem::update(float deltaTime)
+{
+    // Advance every playing instance by at most one frame, as each animation did on its own
+    for (AnimationState& state : states)
     {
-        elapsed_time -= frame_duration;
-        current_frame++;
+        if (!state.isPlaying) continue;
+
+        state.elapsedTime += deltaTime;
+        if (state.elapsedTime < state.clip->frameDuration) continue;
 
-        if (current_frame == frames.size()) {
-            if (loop) current_frame = 0;
+        state.elapsedTime -= state.clip->frameDuration;
+        state.currentFrame++;
+
+        if (state.currentFrame == state.clip->frames.size()) {
+            if (state.clip->loop) state.currentFrame = 0;
             else {
-                isPlaying = false;
-                current_frame = frames.size() - 1;
+                state.isPlaying = false;
+                state.currentFrame = state.clip->frames.size() - 1;
             }
         }
+        applyFrame(state);
     }
-}
-
-void Animation::stop() 
-{
-    // Stop and reset animation
-    isPlaying = false;
-    current_frame = 0;
-    elapsed_time = 0.0f;
 }
\ No newline at end of file
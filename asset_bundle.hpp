@@ -0,0 +1,590 @@
+#pragma once
+
+enum WeaponClass { fastWeapon, mediumWeapon, slowWeapon };
+
+// Animation directories of one dungeon's enemies, by tier, and its boss
+struct EnemySet {
+	std::map<unsigned int, std::string> tiers;
+	std::string boss;
+};
+
+struct WeaponAsset {
+	WeaponClass weaponClass;
+	std::string path;
+};
+
+static const char assetBundleMagic[4] = { 'A', 'S', 'T', 'B' };
+// Bumped whenever the packed set changes, an older bundle is ignored and the assets read from disk
+// (2: HUD digits, 3: source hash)
+static const uint32_t assetBundleVersion = 3;
+
+// Fixed-size header followed by the arrays it points at, laid out like a level file. Names are
+// offsets into a block of zero-terminated strings, pixels are RGBA rows ready for the GPU.
+struct AssetBundleHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t pageCount;
+	uint32_t regionCount;
+	uint32_t animationCount;
+	uint32_t frameCount;
+	uint32_t imageCount;
+	uint32_t enemyCount;
+	uint32_t weaponCount;
+	uint32_t reserved;
+	// getAssetSourceHash() of the files it was packed from, for asset_packer --check
+	uint64_t sourceHash;
+	uint64_t stringsSize;
+	uint64_t pagesOffset;
+	uint64_t regionsOffset;
+	uint64_t animationsOffset;
+	uint64_t framesOffset;
+	uint64_t imagesOffset;
+	uint64_t enemiesOffset;
+	uint64_t weaponsOffset;
+	uint64_t stringsOffset;
+};
+
+// An atlas page, or a whole image such as a tileset
+struct BundleImage {
+	uint32_t name;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+	uint64_t pixelsOffset;
+};
+
+struct BundleRegion {
+	uint32_t name;
+	uint32_t page;
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
+
+// Frames are region indices, frameCount of them from firstFrame on
+struct BundleAnimation {
+	uint32_t name;
+	uint32_t firstFrame;
+	uint32_t frameCount;
+	uint32_t reserved;
+};
+
+// Tier -1 is the boss
+struct BundleEnemy {
+	uint32_t directory;
+	int32_t tier;
+	uint32_t path;
+	uint32_t reserved;
+};
+
+struct BundleWeapon {
+	uint32_t path;
+	uint32_t weaponClass;
+};
+
+// Read-only mapping of a bundle written by asset_packer
+class AssetBundle {
+private:
+
+	MappedFile file;
+	const AssetBundleHeader* header;
+
+	template <class T>
+	bool validArray(uint64_t offset, uint64_t count) const
+	{
+		return offset % alignof(T) == 0 && offset <= file.getSize() && count <= (file.getSize() - offset) / sizeof(T);
+	}
+
+	template <class T>
+	const T* getArray(uint64_t offset) const { return reinterpret_cast<const T*>(file.getData() + offset); }
+
+	bool validRegion(const BundleRegion& region) const
+	{
+		if (region.name >= header->stringsSize || region.page >= header->pageCount) return false;
+
+		const BundleImage& page = getPages()[region.page];
+		return region.x >= 0 && region.y >= 0 && region.width >= 0 && region.height >= 0
+			&& int64_t(region.x) + region.width <= page.width && int64_t(region.y) + region.height <= page.height;
+	}
+
+	bool validImages(const BundleImage* images, uint32_t count) const
+	{
+		for (uint32_t i = 0; i < count; i++) {
+			if (images[i].name >= header->stringsSize || !validArray<uint8_t>(images[i].pixelsOffset, uint64_t(images[i].width) * images[i].height * 4)) return false;
+		}
+		return true;
+	}
+
+public:
+
+	AssetBundle() : header(nullptr) {}
+
+	bool open(const std::string& path)
+	{
+		header = nullptr;
+		if (!file.open(path)) return false;
+
+		if (file.getSize() < sizeof(AssetBundleHeader)) {
+			file.close();
+			return false;
+		}
+
+		header = getArray<AssetBundleHeader>(0);
+
+		bool valid = std::equal(assetBundleMagic, assetBundleMagic + 4, header->magic) && header->version == assetBundleVersion
+			&& header->regionCount > 0 && header->stringsSize > 0
+			&& validArray<BundleImage>(header->pagesOffset, header->pageCount)
+			&& validArray<BundleRegion>(header->regionsOffset, header->regionCount)
+			&& validArray<BundleAnimation>(header->animationsOffset, header->animationCount)
+			&& validArray<uint32_t>(header->framesOffset, header->frameCount)
+			&& validArray<BundleImage>(header->imagesOffset, header->imageCount)
+			&& validArray<BundleEnemy>(header->enemiesOffset, header->enemyCount)
+			&& validArray<BundleWeapon>(header->weaponsOffset, header->weaponCount)
+			&& validArray<char>(header->stringsOffset, header->stringsSize);
+
+		// Every name has to end inside the string block, every index has to point at something
+		valid = valid && getArray<char>(header->stringsOffset)[header->stringsSize - 1] == '\0'
+			&& validImages(getPages(), header->pageCount) && validImages(getImages(), header->imageCount);
+
+		for (uint32_t i = 0; i < header->regionCount && valid; i++) {
+			valid = validRegion(getRegions()[i]);
+		}
+		for (uint32_t i = 0; i < header->animationCount && valid; i++) {
+			const BundleAnimation& animation = getAnimations()[i];
+			valid = animation.name < header->stringsSize && animation.firstFrame <= header->frameCount && animation.frameCount <= header->frameCount - animation.firstFrame;
+		}
+		for (uint32_t i = 0; i < header->frameCount && valid; i++) {
+			valid = getFrames()[i] < header->regionCount;
+		}
+		for (uint32_t i = 0; i < header->enemyCount && valid; i++) {
+			valid = getEnemies()[i].directory < header->stringsSize && getEnemies()[i].path < header->stringsSize;
+		}
+		for (uint32_t i = 0; i < header->weaponCount && valid; i++) {
+			valid = getWeapons()[i].path < header->stringsSize && getWeapons()[i].weaponClass <= slowWeapon;
+		}
+
+		if (!valid) close();
+		return valid;
+	}
+
+	void close()
+	{
+		file.close();
+		header = nullptr;
+	}
+
+	bool isOpen() const { return header != nullptr; }
+
+	uint64_t getSourceHash() const { return header->sourceHash; }
+
+	// Everything below points into the mapping, valid until the bundle is closed
+
+	const char* getString(uint32_t offset) const { return getArray<char>(header->stringsOffset) + offset; }
+
+	const uint8_t* getPixels(const BundleImage& image) const { return getArray<uint8_t>(image.pixelsOffset); }
+
+	const BundleImage* getPages() const { return getArray<BundleImage>(header->pagesOffset); }
+	uint32_t getPageCount() const { return header->pageCount; }
+
+	const BundleRegion* getRegions() const { return getArray<BundleRegion>(header->regionsOffset); }
+	uint32_t getRegionCount() const { return header->regionCount; }
+
+	const BundleAnimation* getAnimations() const { return getArray<BundleAnimation>(header->animationsOffset); }
+	uint32_t getAnimationCount() const { return header->animationCount; }
+
+	const uint32_t* getFrames() const { return getArray<uint32_t>(header->framesOffset); }
+
+	const BundleImage* getImages() const { return getArray<BundleImage>(header->imagesOffset); }
+	uint32_t getImageCount() const { return header->imageCount; }
+
+	const BundleEnemy* getEnemies() const { return getArray<BundleEnemy>(header->enemiesOffset); }
+	uint32_t getEnemyCount() const { return header->enemyCount; }
+
+	const BundleWeapon* getWeapons() const { return getArray<BundleWeapon>(header->weaponsOffset); }
+	uint32_t getWeaponCount() const { return header->weaponCount; }
+
+	// Nullptr if the bundle has no image by that name
+	const BundleImage* findImage(const std::string& path) const
+	{
+		const std::string key = getAssetKey(path);
+		for (uint32_t i = 0; i < header->imageCount; i++) {
+			if (key == getString(getImages()[i].name)) return &getImages()[i];
+		}
+		return nullptr;
+	}
+};
+
+bool TextureAtlas::load(const AssetBundle& bundle)
+{
+	clearPages();
+	m_images.clear();
+	m_pageImages.clear();
+	m_regionIds.clear();
+	m_regions.clear();
+	m_animations.clear();
+
+	// Uploaded straight from the mapping, nothing is decoded or copied on the way
+	bool uploaded = true;
+	for (uint32_t i = 0; i < bundle.getPageCount(); i++) {
+		const BundleImage& page = bundle.getPages()[i];
+
+		sf::Texture* texture = new sf::Texture;
+		if (texture->create(page.width, page.height)) texture->update(bundle.getPixels(page));
+		else uploaded = false;
+		m_pages.push_back(texture);
+	}
+
+	// The packer keeps the region order, so the white block is still the first one
+	for (uint32_t i = 0; i < bundle.getRegionCount(); i++) {
+		const BundleRegion& region = bundle.getRegions()[i];
+		m_regions.push_back({ region.page, sf::IntRect(region.x, region.y, region.width, region.height) });
+
+		const char* name = bundle.getString(region.name);
+		if (*name != '\0') m_regionIds[name] = i;
+	}
+	m_whiteRegion = 0;
+
+	for (uint32_t i = 0; i < bundle.getAnimationCount(); i++) {
+		const BundleAnimation& animation = bundle.getAnimations()[i];
+		const uint32_t* frames = bundle.getFrames() + animation.firstFrame;
+		m_animations[bundle.getString(animation.name)].assign(frames, frames + animation.frameCount);
+	}
+
+	return uploaded;
+}
+
+// Everything in ./assets the game looks up by directory: the enemies of every dungeon and the weapons by class.
+// Read from the bundle when there is one, otherwise found by walking the directories.
+class AssetDirectory {
+private:
+
+	std::map<std::string, EnemySet> enemies;
+	std::vector<WeaponAsset> weapons;
+
+	const AssetBundle* bundle;
+
+	EnemySet noEnemies;
+
+	static int convertDirectoryNameToInt(const std::string& directoryName)
+	{
+		try {
+			return std::stoi(directoryName);
+		}
+		catch (const std::exception& e) {
+			// Handle conversion error
+			throw std::runtime_error("Failed to convert directory name to int: " + std::string(e.what()));
+		}
+	}
+
+	void scanEnemies(const std::string& directoryPath)
+	{
+		EnemySet& set = enemies[getAssetKey(directoryPath)];
+
+		for (const auto& entry : fs::directory_iterator(directoryPath))
+		{
+			if (fs::is_directory(entry.path()))
+			{
+				std::string directoryName = entry.path().filename().string();
+
+				if (directoryName == "boss") {
+					for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
+					{
+						if (fs::is_directory(entry.path()))
+						{
+							set.boss = directoryPath + directoryName + "/" + entry.path().filename().string();
+						}
+					}
+				}
+				else {
+					unsigned int enemyTier = convertDirectoryNameToInt(directoryName);
+					for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
+					{
+						if (fs::is_directory(entry.path()))
+						{
+							std::string enemyAnimPath = directoryPath + directoryName + "/" + entry.path().filename().string();
+							set.tiers.insert(std::make_pair(enemyTier, enemyAnimPath));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void scanWeapons(const std::string& directoryPath)
+	{
+		for (const auto& entry : fs::directory_iterator(directoryPath))
+		{
+			if (fs::is_directory(entry.path()))
+			{
+				std::string directoryName = entry.path().filename().string();
+
+				WeaponClass weaponClass;
+				if (directoryName == "fast") weaponClass = fastWeapon;
+				else if (directoryName == "medium") weaponClass = mediumWeapon;
+				else if (directoryName == "slow") weaponClass = slowWeapon;
+				else continue;
+
+				for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
+				{
+					weapons.push_back({ weaponClass, directoryPath + directoryName + "/" + entry.path().filename().string() });
+				}
+			}
+		}
+	}
+
+public:
+
+	AssetDirectory() : bundle(nullptr) {}
+
+	void scan()
+	{
+		enemies.clear();
+		weapons.clear();
+		bundle = nullptr;
+
+		scanEnemies(dungeon1EnemiesDir);
+		scanEnemies(dungeon2EnemiesDir);
+		scanEnemies(dungeon3EnemiesDir);
+		scanWeapons(weaponsDir);
+	}
+
+	bool load(const AssetBundle& _bundle)
+	{
+		enemies.clear();
+		weapons.clear();
+		bundle = &_bundle;
+
+		for (uint32_t i = 0; i < bundle->getEnemyCount(); i++) {
+			const BundleEnemy& enemy = bundle->getEnemies()[i];
+			EnemySet& set = enemies[bundle->getString(enemy.directory)];
+
+			if (enemy.tier < 0) set.boss = bundle->getString(enemy.path);
+			else set.tiers.insert(std::make_pair(unsigned(enemy.tier), std::string(bundle->getString(enemy.path))));
+		}
+
+		for (uint32_t i = 0; i < bundle->getWeaponCount(); i++) {
+			const BundleWeapon& weapon = bundle->getWeapons()[i];
+			weapons.push_back({ WeaponClass(weapon.weaponClass), bundle->getString(weapon.path) });
+		}
+
+		return true;
+	}
+
+	const EnemySet& getEnemies(const std::string& directoryPath) const
+	{
+		auto it = enemies.find(getAssetKey(directoryPath));
+		return it == enemies.end() ? noEnemies : it->second;
+	}
+
+	const std::map<std::string, EnemySet>& getEnemySets() const { return enemies; }
+
+	const std::vector<WeaponAsset>& getWeapons() const { return weapons; }
+
+	// Copied out of the bundle if it has the image, otherwise decoded from the file
+	bool loadImage(const std::string& path, sf::Image& image) const
+	{
+		const BundleImage* bundled = bundle != nullptr ? bundle->findImage(path) : nullptr;
+		if (bundled == nullptr) return image.loadFromFile(path);
+
+		image.create(bundled->width, bundled->height, bundle->getPixels(*bundled));
+		return true;
+	}
+};
+
+// Digits 0-9 of the HUD font, each in a cell as wide as its advance and as tall as the tallest digit,
+// so a number is laid out by putting the cells side by side
+bool addDigitGlyphs(TextureAtlas& atlas)
+{
+	sf::Font font;
+	if (!font.loadFromFile(hudFont)) return false;
+
+	float top = 0.f, bottom = 0.f;
+	for (char digit = '0'; digit <= '9'; digit++)
+	{
+		const sf::Glyph& glyph = font.getGlyph(digit, hudDigitSize, false);
+		top = std::min(top, glyph.bounds.top);
+		bottom = std::max(bottom, glyph.bounds.top + glyph.bounds.height);
+	}
+
+	// Read back after every digit is rendered, the glyph page may have grown in between
+	const sf::Image glyphs = font.getTexture(hudDigitSize).copyToImage();
+
+	for (char digit = '0'; digit <= '9'; digit++)
+	{
+		const sf::Glyph& glyph = font.getGlyph(digit, hudDigitSize, false);
+
+		sf::Image cell;
+		cell.create((unsigned int)std::ceil(glyph.advance), (unsigned int)std::ceil(bottom - top), sf::Color(255, 255, 255, 0));
+		cell.copy(glyphs, (unsigned int)std::max(0.f, std::floor(glyph.bounds.left)), (unsigned int)std::floor(glyph.bounds.top - top), glyph.textureRect, true);
+
+		atlas.add(hudDigits + std::string(1, digit) + ".png", cell);
+	}
+
+	return true;
+}
+
+// Sprites drawn from the atlas, the same set whether packed at startup or by asset_packer
+void addSpriteDirectories(TextureAtlas& atlas)
+{
+	atlas.addDirectory(heroesDir);
+	atlas.addDirectory(weaponsDir);
+	atlas.addDirectory(potionsDir);
+	atlas.addDirectory(chestDir);
+	atlas.addDirectory(dungeon1EnemiesDir);
+	atlas.addDirectory(dungeon2EnemiesDir);
+	atlas.addDirectory(dungeon3EnemiesDir);
+	atlas.add(healthbarTexture);
+	if (!addDigitGlyphs(atlas)) std::cerr << "Failed to rasterise the HUD digits from " << hudFont << std::endl;
+}
+
+// Too large for an atlas page, stored whole
+std::vector<std::string> getBundledImagePaths()
+{
+	return { dungeon1Tileset, background1Tileset, dungeon2Tileset, background2Tileset, dungeon3Tileset, background3Tileset };
+}
+
+// Hash of the path, size and contents of every file under assetSourceDir, bundles left out. Changing,
+// adding or removing an asset changes it, checking out or copying the assets does not. Reads every
+// asset, so only asset_packer calls it, the game trusts whatever bundle it finds
+uint64_t getAssetSourceHash()
+{
+	std::vector<fs::path> paths;
+
+	std::error_code error;
+	for (fs::recursive_directory_iterator it(assetSourceDir, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->is_regular_file(error) && it->path().extension() != ".bundle") paths.push_back(it->path());
+	}
+
+	// The walk's order depends on the file system, and the root on where the packer runs from
+	std::vector<std::pair<std::string, fs::path>> sources;
+	for (const fs::path& path : paths) sources.emplace_back(path.lexically_relative(assetSourceDir).generic_string(), path);
+	std::sort(sources.begin(), sources.end());
+
+	uint64_t hash = 0;
+	std::vector<char> contents;
+	for (const auto& source : sources) {
+		for (char c : source.first) hash = splitMix64(hash ^ uint8_t(c));
+
+		std::ifstream in(source.second, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		hash = splitMix64(hash ^ contents.size());
+
+		// Eight bytes at a time, the tail zero-padded
+		for (std::size_t i = 0; i < contents.size(); i += 8) {
+			uint64_t word = 0;
+			for (std::size_t j = i; j < std::min(i + 8, contents.size()); j++) word = word << 8 | uint8_t(contents[j]);
+			hash = splitMix64(hash ^ word);
+		}
+	}
+	return hash;
+}
+
+bool writeAssetBundle(const std::string& path, const TextureAtlas& atlas, const AssetDirectory& directory, const std::vector<std::string>& imagePaths)
+{
+	auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+	std::vector<char> strings(1, '\0');
+	auto addString = [&strings](const std::string& string) {
+		uint32_t offset = strings.size();
+		strings.insert(strings.end(), string.begin(), string.end());
+		strings.push_back('\0');
+		return offset;
+	};
+
+	// Region names in region order, the white block and other unnamed regions get the empty string
+	std::vector<BundleRegion> regions;
+	for (const AtlasRegion& region : atlas.getRegions()) {
+		regions.push_back({ 0, region.page, region.rect.left, region.rect.top, region.rect.width, region.rect.height });
+	}
+	for (const auto& entry : atlas.getRegionIds()) regions[entry.second].name = addString(entry.first);
+
+	std::vector<BundleAnimation> animations;
+	std::vector<uint32_t> frames;
+	for (const auto& entry : atlas.getAnimations()) {
+		animations.push_back({ addString(entry.first), uint32_t(frames.size()), uint32_t(entry.second.size()), 0 });
+		frames.insert(frames.end(), entry.second.begin(), entry.second.end());
+	}
+
+	std::vector<BundleEnemy> enemies;
+	for (const auto& entry : directory.getEnemySets()) {
+		const uint32_t directoryName = addString(entry.first);
+		for (const auto& tier : entry.second.tiers) enemies.push_back({ directoryName, int32_t(tier.first), addString(tier.second), 0 });
+		if (!entry.second.boss.empty()) enemies.push_back({ directoryName, -1, addString(entry.second.boss), 0 });
+	}
+
+	std::vector<BundleWeapon> weapons;
+	for (const WeaponAsset& weapon : directory.getWeapons()) weapons.push_back({ addString(weapon.path), uint32_t(weapon.weaponClass) });
+
+	std::vector<sf::Image> decoded;
+	std::vector<BundleImage> images;
+	for (const std::string& imagePath : imagePaths) {
+		sf::Image image;
+		if (!image.loadFromFile(imagePath)) continue;
+		images.push_back({ addString(getAssetKey(imagePath)), image.getSize().x, image.getSize().y, 0, 0 });
+		decoded.push_back(image);
+	}
+
+	const std::vector<sf::Image>& pageImages = atlas.getPageImages();
+	std::vector<BundleImage> pages;
+	for (const sf::Image& page : pageImages) pages.push_back({ 0, page.getSize().x, page.getSize().y, 0, 0 });
+
+	AssetBundleHeader header = {};
+	std::copy(assetBundleMagic, assetBundleMagic + 4, header.magic);
+	header.version = assetBundleVersion;
+	header.sourceHash = getAssetSourceHash();
+	header.pageCount = pages.size();
+	header.regionCount = regions.size();
+	header.animationCount = animations.size();
+	header.frameCount = frames.size();
+	header.imageCount = images.size();
+	header.enemyCount = enemies.size();
+	header.weaponCount = weapons.size();
+	header.stringsSize = strings.size();
+	header.pagesOffset = align(sizeof(AssetBundleHeader));
+	header.regionsOffset = align(header.pagesOffset + pages.size() * sizeof(BundleImage));
+	header.animationsOffset = align(header.regionsOffset + regions.size() * sizeof(BundleRegion));
+	header.framesOffset = align(header.animationsOffset + animations.size() * sizeof(BundleAnimation));
+	header.imagesOffset = align(header.framesOffset + frames.size() * sizeof(uint32_t));
+	header.enemiesOffset = align(header.imagesOffset + images.size() * sizeof(BundleImage));
+	header.weaponsOffset = align(header.enemiesOffset + enemies.size() * sizeof(BundleEnemy));
+	header.stringsOffset = align(header.weaponsOffset + weapons.size() * sizeof(BundleWeapon));
+
+	// Pixels last, each block aligned
+	uint64_t offset = align(header.stringsOffset + strings.size());
+	for (BundleImage& page : pages) {
+		page.pixelsOffset = offset;
+		offset = align(offset + uint64_t(page.width) * page.height * 4);
+	}
+	for (BundleImage& image : images) {
+		image.pixelsOffset = offset;
+		offset = align(offset + uint64_t(image.width) * image.height * 4);
+	}
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) return false;
+
+	uint64_t position = 0;
+	auto write = [&](uint64_t offset, const void* data, uint64_t bytes) {
+		static const char padding[8] = {};
+		out.write(padding, offset - position);
+		if (bytes > 0) out.write(static_cast<const char*>(data), bytes);
+		position = offset + bytes;
+	};
+
+	write(0, &header, sizeof(header));
+	write(header.pagesOffset, pages.data(), pages.size() * sizeof(BundleImage));
+	write(header.regionsOffset, regions.data(), regions.size() * sizeof(BundleRegion));
+	write(header.animationsOffset, animations.data(), animations.size() * sizeof(BundleAnimation));
+	write(header.framesOffset, frames.data(), frames.size() * sizeof(uint32_t));
+	write(header.imagesOffset, images.data(), images.size() * sizeof(BundleImage));
+	write(header.enemiesOffset, enemies.data(), enemies.size() * sizeof(BundleEnemy));
+	write(header.weaponsOffset, weapons.data(), weapons.size() * sizeof(BundleWeapon));
+	write(header.stringsOffset, strings.data(), strings.size());
+
+	for (unsigned int i = 0; i < pages.size(); i++) write(pages[i].pixelsOffset, pageImages[i].getPixelsPtr(), uint64_t(pages[i].width) * pages[i].height * 4);
+	for (unsigned int i = 0; i < images.size(); i++) write(images[i].pixelsOffset, decoded[i].getPixelsPtr(), uint64_t(images[i].width) * images[i].height * 4);
+
+	return bool(out);
+}
\ No newline at end of file
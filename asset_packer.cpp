@@ -0,0 +1,75 @@
+// Offline asset packer: packs the sprites under ./assets into atlas pages, decodes the level tilesets
+// and writes both, with the enemy and weapon listings, into one bundle. The game maps the bundle at
+// startup instead of walking the asset directories and decoding every PNG. Run it from the game's
+// directory whenever the assets change. With --check it only tells whether the bundle was packed from
+// the assets as they are now, exiting with 1 when it was not, for a build step to repack on.
+//
+// Usage: asset_packer [--check] [output file]
+
+#include "includer.hpp"
+
+int main(int argc, char* argv[])
+{
+    const bool check = argc > 1 && std::string(argv[1]) == "--check";
+    const int pathArgument = check ? 2 : 1;
+    const std::string outputPath = argc > pathArgument ? argv[pathArgument] : assetBundlePath;
+
+    if (check) {
+        AssetBundle bundle;
+        if (!bundle.open(outputPath)) {
+            std::cout << outputPath << " is missing or from another version, run asset_packer" << std::endl;
+            return 1;
+        }
+        if (bundle.getSourceHash() != getAssetSourceHash()) {
+            std::cout << outputPath << " is older than the assets, run asset_packer" << std::endl;
+            return 1;
+        }
+        std::cout << outputPath << " is up to date" << std::endl;
+        return 0;
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    ThreadPool pool;
+
+    TextureAtlas atlas;
+    addSpriteDirectories(atlas);
+    atlas.decode(&pool);
+    atlas.pack();
+
+    AssetDirectory directory;
+    try {
+        directory.scan();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    const std::vector<std::string> imagePaths = getBundledImagePaths();
+
+    if (!writeAssetBundle(outputPath, atlas, directory, imagePaths)) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    AssetBundle bundle;
+    if (!bundle.open(outputPath)) {
+        std::cerr << "Written bundle does not validate: " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Sprites:      " << atlas.getRegionIds().size() << std::endl;
+    std::cout << "Animations:   " << bundle.getAnimationCount() << std::endl;
+    std::cout << "Atlas pages:  " << bundle.getPageCount() << " (" << std::min(atlasPageSize, sf::Texture::getMaximumSize()) << " px wide)" << std::endl;
+    std::cout << "Images:       " << bundle.getImageCount() << " of " << imagePaths.size() << std::endl;
+    std::cout << "Enemies:      " << bundle.getEnemyCount() << " in " << directory.getEnemySets().size() << " dungeons" << std::endl;
+    std::cout << "Weapons:      " << bundle.getWeaponCount() << std::endl;
+    std::cout << "Bundle size:  " << fs::file_size(outputPath) / 1024.0 << " KiB" << std::endl;
+    std::cout << "Packed in:    " << seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Output:       " << outputPath << std::endl;
+
+    return 0;
+}
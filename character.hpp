@@ -1,92 +1,16 @@
 #pragma once
 
-class Healthbar : public sf::Drawable, public sf::Transformable
-{
-private:
-
-    sf::VertexArray m_vertices;
-    sf::Texture m_healthbar;
-
-    unsigned int maxHearts;
-
-    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
-    {
-        // apply the transform
-        states.transform *= getTransform();
-
-        // apply the tileset texture
-        states.texture = &m_healthbar;
-
-        // draw the vertex array
-        target.draw(m_vertices, states);
-    }
-
-public:
-
-    Healthbar() : maxHearts(0) {}
-
-    bool load(const std::string& healthbar, unsigned int _maxHitPoints)
-    {
-        if (!m_healthbar.loadFromFile(healthbar)) return false;
-
-        maxHearts = _maxHitPoints / 2;
-        m_vertices.setPrimitiveType(sf::Quads);
-        m_vertices.resize(maxHearts * 4);
-
-        return true;
-    }
-
-    void resize(unsigned int _maxHitPoints)
-    {
-        maxHearts = _maxHitPoints / 2;
-        m_vertices.setPrimitiveType(sf::Quads);
-        m_vertices.resize(maxHearts * 4);
-    }
-
-    void update(const sf::Vector2f& starting_position, unsigned int _currentHitPoints)
-    {
-        unsigned int fullHearts = _currentHitPoints / 2;
-        unsigned int halfHeart = _currentHitPoints % 2 == 0 ? 0 : 1;
-
-        for (unsigned int i = 0; i < maxHearts; i++)
-        {
-            sf::Vertex* quad = &m_vertices[i * 4];
-
-            quad[0].position = sf::Vector2f(starting_position.x + (i * tileSize.x), starting_position.y);
-            quad[1].position = sf::Vector2f(starting_position.x + ((i + 1) * tileSize.x), starting_position.y);
-            quad[2].position = sf::Vector2f(starting_position.x + ((i + 1) * tileSize.x), starting_position.y + tileSize.y);
-            quad[3].position = sf::Vector2f(starting_position.x + (i * tileSize.x), starting_position.y + tileSize.y);
-
-            if (i < fullHearts) {
-                quad[0].texCoords = sf::Vector2f(0, 0);
-                quad[1].texCoords = sf::Vector2f(16, 0);
-                quad[2].texCoords = sf::Vector2f(16, 16);
-                quad[3].texCoords = sf::Vector2f(0, 16);
-            }
-            else if (i < fullHearts + halfHeart) {
-                quad[0].texCoords = sf::Vector2f(16, 0);
-                quad[1].texCoords = sf::Vector2f(32, 0);
-                quad[2].texCoords = sf::Vector2f(32, 16);
-                quad[3].texCoords = sf::Vector2f(16, 16);
-            }
-            else {
-                quad[0].texCoords = sf::Vector2f(32, 0);
-                quad[1].texCoords = sf::Vector2f(48, 0);
-                quad[2].texCoords = sf::Vector2f(48, 16);
-                quad[3].texCoords = sf::Vector2f(32, 16);
-            }
-        }
-    }
-};
-
 class Character {
 protected:
 
-    Animation idle_animation;
-    Animation run_animation;
-    Animation* current_animation;
+    // Clips are shared by every character of the kind, only the playback slot is this character's
+    AnimationSystem* animations;
+    const AnimationClip* idle_animation;
+    const AnimationClip* run_animation;
+    unsigned int animation;
 
     sf::Sprite sprite;
+    RenderNode renderNode;
 
     bool isRunning;
     float movement_spd;
@@ -97,17 +21,13 @@ protected:
     void playIdleAnimation()
     {
         // Update current animation to idle animation
-        if (current_animation != &idle_animation) current_animation->stop();
-        current_animation = &idle_animation;
-        current_animation->play();
+        animations->play(animation, idle_animation);
     }
 
     void playRunAnimation()
     {
         // Update current animation to run animation
-        if (current_animation != &run_animation) current_animation->stop();
-        current_animation = &run_animation;
-        current_animation->play();
+        animations->play(animation, run_animation);
     }
 
     void move(sf::Vector2f movementVector, const float& deltaTime)
@@ -139,25 +59,28 @@ protected:
 
 public:
 
-    Character(std::string _idleAnim, std::string _runAnim, float _movement_spd, unsigned int _maxHitPoints) 
-        : idle_animation(0.1f, 4, true), run_animation(0.1f, 4, true), movement_spd(_movement_spd), maxHitPoints(_maxHitPoints), currentHitPoints(_maxHitPoints), isRunning(false)
+    Character(AnimationSystem* _animations, std::string _idleAnim, std::string _runAnim, float _movement_spd, unsigned int _maxHitPoints) 
+        : animations(_animations), renderNode(&sprite), movement_spd(_movement_spd), maxHitPoints(_maxHitPoints), currentHitPoints(_maxHitPoints), isRunning(false)
     {
-        // Load textures for idle animation
-        idle_animation.load(_idleAnim);
-
-        // Load textures for run animation
-        run_animation.load(_runAnim);
+        // Frames for idle and run animations
+        idle_animation = animations->getClip(_idleAnim, 4, 0.1f, true);
+        run_animation = animations->getClip(_runAnim, 4, 0.1f, true);
 
         // Start with idle animation
-        current_animation = &idle_animation;
-        current_animation->play();
+        animation = animations->create(idle_animation, &sprite);
+        animations->play(animation);
 
         // Set sprite's origin to it's center on x axis
-        sf::Texture texture = current_animation->getCurrentFrame();
-        sf::Vector2f spriteSize(texture.getSize().x, texture.getSize().y);
+        const sf::IntRect& frame = animations->getCurrentFrame(animation).rect;
+        sf::Vector2f spriteSize(frame.width, frame.height);
         sprite.setOrigin(sf::Vector2f(spriteSize.x * 0.5f, spriteSize.y));
     }
 
+    ~Character()
+    {
+        animations->destroy(animation);
+    }
+
     virtual void takeDamage(unsigned int damage) { currentHitPoints -= damage; }
 
     int getCurrentHP() const { return currentHitPoints; }
@@ -171,6 +94,8 @@ public:
     void setPosition(const sf::Vector2f& position) { sprite.setPosition(position); }
 
     sf::Sprite& getSprite() { return sprite; }
+
+    RenderNode& getRenderNode() { return renderNode; }
 };
 
 class PlayerCharacter : public Character {
@@ -178,8 +103,6 @@ protected:
 
     Weapon* currentWeapon;
 
-    Healthbar healthbar;
-
     sf::Clock attackClock;
     sf::Time attackCooldown;
 
@@ -271,25 +194,19 @@ protected:
     }
 
 public:
-    PlayerCharacter(std::string _idleAnim, std::string _runAnim, float _movement_spd, int _maxHitPoints) 
-        : Character(_idleAnim, _runAnim, _movement_spd, _maxHitPoints), currentWeapon(nullptr), attackCooldown(sf::seconds(0))
+    PlayerCharacter(AnimationSystem* animations, std::string _idleAnim, std::string _runAnim, float _movement_spd, int _maxHitPoints) 
+        : Character(animations, _idleAnim, _runAnim, _movement_spd, _maxHitPoints), currentWeapon(nullptr), attackCooldown(sf::seconds(0))
     {
-        healthbar.load(healthbarTexture, _maxHitPoints);
         boostedMvSpeed = movement_spd + 1.5f;
         normalMvSpeed = movement_spd;
     }
 
-    void update(const float& deltaTime, const sf::Vector2f viewportPosition)
+    void update(const float& deltaTime)
     {
         isRunning = false;
 
         getInputs(deltaTime);
         handleAnimations();
-        healthbar.update(viewportPosition, currentHitPoints);
-
-        // Set sprite texture based on animation currently playing
-        current_animation->update(deltaTime);
-        sprite.setTexture(current_animation->getCurrentFrame());
 
         currentWeapon->playAttackAnimation(deltaTime);
     }
@@ -306,11 +223,21 @@ public:
     { 
         Weapon* ptr = currentWeapon;
         currentWeapon = weapon; 
+        renderNode.attach(&currentWeapon->getSprite());
         attackCooldown = sf::seconds(currentWeapon->getAttackCooldown());
         currentWeapon->setPosition(sf::Vector2f(sprite.getPosition().x, sprite.getPosition().y - 3.f));
         return ptr;
     }
 
+    // Hands the weapon back, e.g. to the pool when the player is replaced
+    Weapon* unequipWeapon()
+    {
+        Weapon* ptr = currentWeapon;
+        currentWeapon = nullptr;
+        renderNode.attach(nullptr);
+        return ptr;
+    }
+
     bool canAttack(const float& dt)
     {
         if (sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
@@ -347,8 +274,6 @@ public:
         return defaultHitbox;
     }
     
-    Healthbar& getHealthbar() { return healthbar; }
-
     unsigned int getWeaponDamage() const { return currentWeapon->getDamage(); }
 
     sf::FloatRect getHitbox() const 
@@ -357,16 +282,13 @@ public:
         return sf::FloatRect(defaultBounds.left, defaultBounds.top + defaultBounds.height / 2, defaultBounds.width, defaultBounds.height / 2);
     }
 
-    void addItem(Item* item)
+    void addItem(ItemKind kind)
     {
-        if (HealingPotion* derived = dynamic_cast<HealingPotion*>(item)) {
-            healingPotions++;
-        }
-        else if (SpeedPotion* derived = dynamic_cast<SpeedPotion*>(item)) {
-            speedPotions++;
-        }
-        else if (InvincibilityPotion* derived = dynamic_cast<InvincibilityPotion*>(item)) {
-            invincibilityPotions++;
+        switch (kind) {
+        case healingPotion: healingPotions++; break;
+        case speedPotion: speedPotions++; break;
+        case invincibilityPotion: invincibilityPotions++; break;
+        default: break;
         }
     }
 
@@ -377,13 +299,14 @@ public:
 
 void WeaponContainer::update(PlayerCharacter* player) {
     if (player->interact()) {
-        for (auto it = activeWeapons.begin(); it != activeWeapons.end(); ++it) 
+        for (std::size_t i = 0; i < activeWeapons.size(); i++) 
         {
-            Weapon* weapon = *it;
+            Weapon* weapon = activeWeapons[i];
             if (weapon->getSprite().getGlobalBounds().intersects(player->getGlobalBounds())) 
             {
-                activeWeapons.erase(it);
-                activeWeapons.push_back(player->equipWeapon(weapon));
+                activeWeapons.eraseAt(i);
+                if (renderQueue != nullptr) renderQueue->remove(weapon->getRenderNode());
+                addWeapon(player->equipWeapon(weapon));
                 player->restartInteractClock();
                 return;
             }
@@ -393,97 +316,17 @@ void WeaponContainer::update(PlayerCharacter* player) {
 
 void ItemContainer::update(PlayerCharacter* player) {
     if (player->interact()) {
-        for (auto it = items.begin(); it != items.end(); ++it)
+        for (std::size_t i = 0; i < items.size(); i++)
         {
-            auto item = *it;
+            Item* item = items[i];
             if (item->getSprite().getGlobalBounds().intersects(player->getGlobalBounds()))
             {
-                items.erase(it);
-                player->addItem(item);
+                items.eraseAt(i);
+                player->addItem(item->getKind());
+                release(item);
                 player->restartInteractClock();
                 return;
             }
         }
     }
-}
-
-class EnemyCharacter : public Character {
-protected:
-
-    sf::Clock moveClock;
-    sf::Time moveTime;
-    sf::Time idleTime;
-
-    unsigned int damage;
-    float playerDetectRange = 7;
-
-    sf::RectangleShape healthbar;
-
-    float healthbarSize;
-    float healthbarYOffset;
-
-    void calculateMoveDirection(const sf::Vector2f& playerPosition, const float& dt) 
-    {
-        sf::Vector2f position = getPosition();
-        sf::Vector2f direction = playerPosition - position;
-
-        float distance = std::sqrt(pow(position.x - playerPosition.x, 2) + pow(position.y - playerPosition.y, 2));
-
-        if ((distance / tileSize.x) <= playerDetectRange) move(direction, dt);
-    }
-
-    bool canMove() 
-    { 
-        if (moveClock.getElapsedTime() <= moveTime) {
-            return true;
-        }
-        else if (moveClock.getElapsedTime() >= moveTime + idleTime) {
-            moveClock.restart();
-            return true;
-        }
-        return false;
-    }
-
-    bool playerDetected(const sf::FloatRect& playerBounds) { return playerBounds.intersects(getGlobalBounds()); }
-
-public:
-    EnemyCharacter(std::string _idleAnim, std::string _runAnim, float _movement_spd, int _hitPoints, float _healthbarSize = 12.f, float _healthbarYOffset = 18.f)
-        : Character(_idleAnim, _runAnim, _movement_spd, _hitPoints), damage(1), healthbarSize(_healthbarSize), healthbarYOffset(_healthbarYOffset)
-    {
-        int move_time = getRandomInRange(5, 20);
-        int idle_time = getRandomInRange(0, 5);
-
-        moveClock.restart();
-
-        moveTime = sf::seconds(move_time);
-        idleTime = sf::seconds(idle_time);
-
-        healthbar = sf::RectangleShape(sf::Vector2f(healthbarSize, 1));
-        healthbar.setFillColor(sf::Color::Red);
-    }
-
-    void update(const float& deltaTime, PlayerCharacter* player)
-    {
-        isRunning = false;
-
-        if (canMove()) {
-            calculateMoveDirection(player->getPosition(), deltaTime);
-        }
-
-        if (playerDetected(player->getHitbox())) {
-            player->takeDamage(damage);
-        }
-
-        handleAnimations();
-
-        // Set sprite texture based on animation currently playing
-        current_animation->update(deltaTime);
-        sprite.setTexture(current_animation->getCurrentFrame());
-
-        float healthPercentage = (float)currentHitPoints / (float)maxHitPoints;
-        healthbar.setSize(sf::Vector2f(healthbarSize * healthPercentage, 1));
-        healthbar.setPosition(sf::Vector2f(getPosition().x - healthbarSize / 2, getPosition().y - healthbarYOffset));
-    }
-
-    sf::RectangleShape& getHealthbar() { return healthbar; }
-};
\ No newline at end of file
+}
\ No newline at end of file
@@ -4,32 +4,34 @@ class Chest {
 private:
 
 	sf::Sprite sprite;
+	RenderNode renderNode;
 
 	Weapon* containedWeapon;
 	bool isOpen;
-	Animation openAnim;
+
+	AnimationSystem* animations;
+	unsigned int openAnim;
 
 public:
 
 	~Chest()
 	{
 		delete containedWeapon;
+		animations->destroy(openAnim);
 	}
 
-	Chest(WeaponContainer* weaponPool) : isOpen(false), openAnim(0.1f, 3, false)
+	Chest(WeaponContainer* weaponPool, RandomGenerator* random, AnimationSystem* _animations) : renderNode(&sprite), isOpen(false), animations(_animations)
 	{
-		openAnim.load(chestOpenAnim);
+		openAnim = animations->create(animations->getClip(chestOpenAnim, 3, 0.1f, false), &sprite);
 
-		int weaponIndex = getRandomInRange(0, weaponPool->getCurrentSize() - 1);
+		int weaponIndex = random->getInRange(lootStream, 0, weaponPool->getCurrentSize() - 1);
 
 		containedWeapon = weaponPool->removeByIndex(weaponIndex);
-
-		sprite.setTexture(openAnim.getCurrentFrame());
 	}
 
 	Weapon* open()
 	{
-		openAnim.play();
+		animations->play(openAnim);
 		isOpen = true;
 
 		containedWeapon->setPosition(sf::Vector2f(sprite.getPosition().x + 20.f, sprite.getPosition().y + 20.f));
@@ -39,65 +41,79 @@ public:
 		return ptr;
 	}
 
-	void update(const float& dt)
-	{
-		openAnim.update(dt);
-		sprite.setTexture(openAnim.getCurrentFrame());
-	}
-
 	void setPosition(const sf::Vector2f& position) { sprite.setPosition(position); }
 
 	sf::Sprite& getSprite() { return sprite; }
+
+	RenderNode& getRenderNode() { return renderNode; }
 	
 	bool isChestOpen() { return isOpen; }
+
+	// The weapon of a chest that was never opened, nullptr once it was
+	Weapon* takeWeapon()
+	{
+		Weapon* ptr = containedWeapon;
+		containedWeapon = nullptr;
+		return ptr;
+	}
 };
 
 class ChestContainer {
 private:
 
-	std::vector<Chest*> chests;
+	SlotMap<Chest*> chests;
 	
 	WeaponContainer* weaponPool;
 	WeaponContainer* weaponsOnGround;
 
+	RandomGenerator* random;
+	AnimationSystem* animations;
+	RenderQueue* renderQueue;
+
 public:
 
+	// The pool may be gone by now, unopened chests delete their weapons
 	~ChestContainer()
 	{
-		reset();
+		for (Chest* chest : chests) {
+			delete chest;
+		}
 	}
 
-	ChestContainer(WeaponContainer* wP, WeaponContainer* wOG) : weaponPool(wP), weaponsOnGround(wOG) {}
+	ChestContainer(WeaponContainer* wP, WeaponContainer* wOG, RandomGenerator* rG, AnimationSystem* aS, RenderQueue* rQ) : weaponPool(wP), weaponsOnGround(wOG), random(rG), animations(aS), renderQueue(rQ) {}
 
+	// Weapons of unopened chests go back to the pool
 	void reset() 
 	{
 		for (Chest* chest : chests) {
+			Weapon* weapon = chest->takeWeapon();
+			if (weapon != nullptr) weaponPool->addWeapon(weapon);
 			delete chest;
 		}
 		chests.clear();
 	}
 
-	void spawnChests(const std::vector<Room*> chestRooms)
+	void spawnChests(const LevelLayout& level)
 	{
 		reset();
 
-		for (const Room* room : chestRooms)
+		for (uint32_t i = 0; i < level.chestRoomCount; i++)
 		{
-			chests.push_back(new Chest(weaponPool));
+			const LevelRect& room = level.rooms[level.chestRooms[i]];
 
-			unsigned int x = (room->getX() + room->getWidth() / 2) * tileSize.x;
-			unsigned int y = (room->getY() + room->getHeight() / 2) * tileSize.y;
+			Chest* chest = new Chest(weaponPool, random, animations);
+			chests.insert(chest);
 
-			chests.back()->setPosition(sf::Vector2f(x, y));
+			unsigned int x = (room.x + room.width / 2) * tileSize.x;
+			unsigned int y = (room.y + room.height / 2) * tileSize.y;
+
+			chest->setPosition(sf::Vector2f(x, y));
+			renderQueue->add(chest->getRenderNode());
 		}
 	}
 
-	void update(const float& dt, PlayerCharacter* player)
+	void update(PlayerCharacter* player)
 	{
-		for (Chest* chest : chests) {
-			chest->update(dt);
-		}
-
 		if (player->interact())
 		{
 			for (Chest* chest : chests) 
@@ -110,13 +126,4 @@ public:
 			}
 		}
 	}
-
-	std::vector<sf::Sprite> getChestSprites() 
-	{
-		std::vector<sf::Sprite> v;
-		for (Chest* chest : chests) {
-			v.push_back(chest->getSprite());
-		}
-		return v;
-	}
 };
\ No newline at end of file
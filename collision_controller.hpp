@@ -1,139 +1,301 @@
 #pragma once
 
+// Keeps characters on the floor of rooms and corridors. The floor is copied into a grid of tiles once
+// per level, together with the nearest floor tile of every other tile, so checking a character and
+// pushing it back out of a wall are a handful of lookups however many rooms the level has
 class CollisionController {
 private:
-	std::vector<sf::FloatRect*> roomBounds;
-	std::vector<sf::FloatRect*> corridorBounds;
 
-	sf::Vector2f tl;
-	sf::Vector2f tr;
-	sf::Vector2f bl;
-	sf::Vector2f br;
+	// Levels added since the last clear(), each with its offset in tiles, read by build()
+	struct FloorSource {
+		const LevelLayout* level;
+		int32_t offsetX;
+		int32_t offsetY;
+	};
+	std::vector<FloorSource> sources;
 
-	sf::FloatRect* nearestRoom;
+	// Tile of the grid's top left corner; endless mode sectors can lie left of or above the origin
+	int32_t gridX;
+	int32_t gridY;
+	int32_t gridWidth;
+	int32_t gridHeight;
 
-	bool outsideBounds;
+	// Row-major, one entry per tile
+	std::vector<uint8_t> walkable;
+	std::vector<int32_t> nearestWalkable;
 
-	sf::Vector2f characterPosition;
-	sf::FloatRect characterBounds;
+	// Scratch for build(), kept so endless mode rebuilds allocate nothing once grown
+	std::vector<int32_t> frontier;
 
-	void createCollisionPoints() 
+	// std::floor is a library call on most targets, and this runs for four points of every character each frame
+	static int32_t floorToInt(float value)
 	{
-		tl = sf::Vector2f(characterBounds.left, characterBounds.top + characterBounds.height / 2);
-		tr = sf::Vector2f(characterBounds.left + characterBounds.width, characterBounds.top + characterBounds.height / 2);
-		bl = sf::Vector2f(characterBounds.left, characterBounds.top + characterBounds.height);
-		br = sf::Vector2f(characterBounds.left + characterBounds.width, characterBounds.top + characterBounds.height);
+		const int32_t truncated = int32_t(value);
+		return value < float(truncated) ? truncated - 1 : truncated;
 	}
 
-	bool checkPointCollision(const sf::Vector2f& point)
+	// Index of the tile under the point, the nearest tile of the grid's edge for points outside it
+	int32_t getCell(const sf::Vector2f& point, bool& inside) const
 	{
-		for (sf::FloatRect* roomBounds : roomBounds) {
-			if (roomBounds->contains(point)) {
-				return true;
-			}
-		}
-		for (sf::FloatRect* corridorBounds : corridorBounds) {
-			if (corridorBounds->contains(point)) {
-				return true;
-			}
-		}
-		return false;
+		const int32_t x = floorToInt(point.x / tileSize.x) - gridX;
+		const int32_t y = floorToInt(point.y / tileSize.y) - gridY;
+		inside = x >= 0 && y >= 0 && x < gridWidth && y < gridHeight;
+
+		return std::min(std::max(y, 0), gridHeight - 1) * gridWidth + std::min(std::max(x, 0), gridWidth - 1);
 	}
 
-	bool pointOutsideBounds() 
+	// Shortest move of the point onto the tile. Stops just short of the tile's right and bottom edges,
+	// which belong to the next tiles
+	sf::Vector2f getPushInto(const sf::Vector2f& point, int32_t cell) const
 	{
-		if (!checkPointCollision(tl)) {
-			findClosestRoom(tl);
-			return true;
-		}
-		if (!checkPointCollision(tr)) {
-			findClosestRoom(tr);
-			return true;
-		}
-		if (!checkPointCollision(bl)) {
-			findClosestRoom(bl);
-			return true;
-		}
-		if (!checkPointCollision(br)) {
-			findClosestRoom(br);
-			return true;
-		}
+		const float inset = 0.01f;
+		const float tileLeft = float((cell % gridWidth + gridX) * int32_t(tileSize.x));
+		const float tileTop = float((cell / gridWidth + gridY) * int32_t(tileSize.y));
 
-		return false;
+		return sf::Vector2f(std::min(std::max(point.x, tileLeft), tileLeft + tileSize.x - inset) - point.x, std::min(std::max(point.y, tileTop), tileTop + tileSize.y - inset) - point.y);
 	}
 
-	void findClosestRoom(const sf::Vector2f& point) 
-	{
-		float nearestDistance = std::numeric_limits<float>::max();
-
-		for (sf::FloatRect* room : roomBounds) {
+	static float getLengthSquared(const sf::Vector2f& vector) { return vector.x * vector.x + vector.y * vector.y; }
 
-			sf::Vector2f newPosition = getNewPosition(room);
-			float distance = std::sqrt(std::pow(characterPosition.x - newPosition.x, 2) + std::pow(characterPosition.y - newPosition.y, 2));
+	// Calls visit with each floor tile of the eight around the cell
+	template <typename Visit>
+	void forEachWalkableAround(int32_t cell, Visit visit) const
+	{
+		const int32_t x = cell % gridWidth;
+		const int32_t y = cell / gridWidth;
 
-			if (distance < nearestDistance)
-			{
-				nearestDistance = distance;
-				nearestRoom = room;
+		for (int32_t ny = std::max(y - 1, 0); ny <= std::min(y + 1, gridHeight - 1); ny++) {
+			for (int32_t nx = std::max(x - 1, 0); nx <= std::min(x + 1, gridWidth - 1); nx++) {
+				const int32_t neighbour = ny * gridWidth + nx;
+				if (neighbour != cell && walkable[neighbour]) visit(neighbour);
 			}
 		}
+	}
+
+	bool fits(const sf::Vector2f (&points)[4], const sf::Vector2f& shift) const
+	{
+		for (const sf::Vector2f& point : points) {
+			if (!isWalkable(point + shift)) return false;
+		}
+		return true;
+	}
 
-		for (sf::FloatRect* room : corridorBounds) {
+	void tryShift(const sf::Vector2f (&points)[4], const sf::Vector2f& shift, sf::Vector2f& best, bool& found) const
+	{
+		if ((found && getLengthSquared(shift) >= getLengthSquared(best)) || !fits(points, shift)) return;
 
-			sf::Vector2f newPosition = getNewPosition(room);
-			float distance = std::sqrt(std::pow(characterPosition.x - newPosition.x, 2) + std::pow(characterPosition.y - newPosition.y, 2));
+		best = shift;
+		found = true;
+	}
 
-			if (distance < nearestDistance)
-			{
-				nearestDistance = distance;
-				nearestRoom = room;
+	// Marks the tiles of the rectangle, offset by the source's, as floor
+	void markFloor(const LevelRect& rect, const FloorSource& source)
+	{
+		for (int32_t y = rect.y + source.offsetY - gridY; y < rect.y + rect.height + source.offsetY - gridY; y++) {
+			for (int32_t x = rect.x + source.offsetX - gridX; x < rect.x + rect.width + source.offsetX - gridX; x++) {
+				walkable[y * gridWidth + x] = 1;
 			}
 		}
 	}
 
-	sf::Vector2f& getNewPosition(const sf::FloatRect* room) 
+	// Tiles covered by the level: its tile grid, or its rooms and corridors when it has none
+	static sf::IntRect getExtent(const LevelLayout& level)
 	{
-		sf::Vector2f position;
-		position.x = std::max(room->left + characterBounds.width / 2, std::min(characterPosition.x, room->left + room->width - characterBounds.width / 2));
-		position.y = std::max(room->top + characterBounds.height / 2, std::min(characterPosition.y, room->top + room->height));
-		return position;
+		if (level.tiles != nullptr) return sf::IntRect(0, 0, level.gridWidth, level.gridHeight);
+
+		int32_t left = std::numeric_limits<int32_t>::max();
+		int32_t top = std::numeric_limits<int32_t>::max();
+		int32_t right = std::numeric_limits<int32_t>::min();
+		int32_t bottom = std::numeric_limits<int32_t>::min();
+
+		auto extend = [&](const LevelRect& rect) {
+			left = std::min(left, rect.x);
+			top = std::min(top, rect.y);
+			right = std::max(right, rect.x + rect.width);
+			bottom = std::max(bottom, rect.y + rect.height);
+		};
+		for (uint32_t i = 0; i < level.roomCount; i++) extend(level.rooms[i]);
+		for (uint32_t i = 0; i < level.corridorCount; i++) extend(level.corridors[i]);
+
+		if (left > right) return sf::IntRect();
+		return sf::IntRect(left, top, right - left, bottom - top);
 	}
 
 public:
-	CollisionController() : outsideBounds(false), nearestRoom(nullptr) {}
 
-	~CollisionController() {
-		for (sf::FloatRect* room : roomBounds) delete room;
-		for (sf::FloatRect* corridor : corridorBounds) delete corridor;
+	CollisionController() : gridX(0), gridY(0), gridWidth(0), gridHeight(0) {}
+
+	void load(const LevelLayout& level)
+	{
+		clear();
+		addLevel(level, sf::Vector2f(0.f, 0.f));
+		build();
 	}
 
-	void load(const std::vector<Room*> rooms, const std::vector<Corridor*> corridors)
+	void clear()
 	{
-		// Create bounds for rooms and corridors
-		roomBounds.clear();
-		for (const Room* room : rooms) {
-			const sf::Vector2f position(room->x * tileSize.x, room->y * tileSize.y);
-			const sf::Vector2f size(room->width * tileSize.x, room->height * tileSize.y);
-			roomBounds.push_back(new sf::FloatRect(position, size));
+		sources.clear();
+	}
+
+	// Adds the floor of a level placed offset pixels from the origin, used to join endless mode sectors.
+	// Takes effect with the next build(), the level has to stay alive until then
+	void addLevel(const LevelLayout& level, const sf::Vector2f& offset)
+	{
+		sources.push_back({ &level, int32_t(std::lround(offset.x / tileSize.x)), int32_t(std::lround(offset.y / tileSize.y)) });
+	}
+
+	// Copies the floor of every level into the grid and fills in the nearest floor tile of every wall
+	// tile, by a breadth-first sweep out from the floor, so the nearest tile is the fewest steps away
+	// along the grid. Linear in the tiles covered: a level of the campaign, or the at most
+	// (2 * sectorEvictRadius + 1)^2 sectors endless mode keeps, which take about a millisecond
+	void build()
+	{
+		// One tile of wall around the floor, so every character next to it stays inside the grid
+		int32_t left = std::numeric_limits<int32_t>::max();
+		int32_t top = std::numeric_limits<int32_t>::max();
+		int32_t right = std::numeric_limits<int32_t>::min();
+		int32_t bottom = std::numeric_limits<int32_t>::min();
+
+		for (const FloorSource& source : sources) {
+			const sf::IntRect extent = getExtent(*source.level);
+			if (extent.width <= 0 || extent.height <= 0) continue;
+
+			left = std::min(left, extent.left + source.offsetX);
+			top = std::min(top, extent.top + source.offsetY);
+			right = std::max(right, extent.left + extent.width + source.offsetX);
+			bottom = std::max(bottom, extent.top + extent.height + source.offsetY);
+		}
+
+		if (left > right) {
+			gridWidth = gridHeight = 0;
+			return;
 		}
 
-		corridorBounds.clear();
-		for (const Corridor* corridor : corridors) {
-			const sf::Vector2f position(corridor->x1 * tileSize.x, corridor->y1 * tileSize.y);
-			const sf::Vector2f size(corridor->width * tileSize.x, corridor->height * tileSize.y);
-			corridorBounds.push_back(new sf::FloatRect(position, size));
+		gridX = left - 1;
+		gridY = top - 1;
+		gridWidth = right - left + 2;
+		gridHeight = bottom - top + 2;
+
+		const std::size_t cellCount = std::size_t(gridWidth) * gridHeight;
+		walkable.assign(cellCount, 0);
+		nearestWalkable.assign(cellCount, -1);
+		frontier.clear();
+
+		// The level's tile grid is where the floor is decided, rooms and corridors only stand in for it
+		// in endless mode sectors, which have none
+		for (const FloorSource& source : sources) {
+			const LevelLayout& level = *source.level;
+
+			if (level.tiles != nullptr) {
+				for (int32_t y = 0; y < level.gridHeight; y++) {
+					const uint8_t* tiles = &level.tiles[std::size_t(y) * level.gridWidth];
+					uint8_t* row = &walkable[std::size_t(y + source.offsetY - gridY) * gridWidth + source.offsetX - gridX];
+					for (int32_t x = 0; x < level.gridWidth; x++) row[x] |= tiles[x] == floorTile || tiles[x] == corridorTile;
+				}
+			}
+			else {
+				for (uint32_t i = 0; i < level.roomCount; i++) markFloor(level.rooms[i], source);
+				for (uint32_t i = 0; i < level.corridorCount; i++) markFloor(level.corridors[i], source);
+			}
 		}
+
+		// Nothing reads the levels after this, so no pointer to one outlives it
+		sources.clear();
+
+		for (int32_t cell = 0; cell < int32_t(cellCount); cell++) {
+			if (!walkable[cell]) continue;
+
+			nearestWalkable[cell] = cell;
+			frontier.push_back(cell);
+		}
+
+		for (std::size_t i = 0; i < frontier.size(); i++)
+		{
+			const int32_t cell = frontier[i];
+			const int32_t x = cell % gridWidth;
+			const int32_t y = cell / gridWidth;
+
+			const int32_t neighbours[4] = { x > 0 ? cell - 1 : -1, x + 1 < gridWidth ? cell + 1 : -1, y > 0 ? cell - gridWidth : -1, y + 1 < gridHeight ? cell + gridWidth : -1 };
+			for (int32_t neighbour : neighbours) {
+				if (neighbour < 0 || nearestWalkable[neighbour] >= 0) continue;
+
+				nearestWalkable[neighbour] = nearestWalkable[cell];
+				frontier.push_back(neighbour);
+			}
+		}
+	}
+
+	bool isWalkable(const sf::Vector2f& point) const
+	{
+		if (gridWidth == 0) return false;
+
+		bool inside;
+		const int32_t cell = getCell(point, inside);
+		return inside && walkable[cell];
 	}
 
-	void update(Character* character) 
+	// Where a character with these bounds, standing at position, has to be put back to stay on the floor.
+	// The two bottom corners and the two points halfway up its sides must be on floor tiles. Each one that
+	// is not is moved the shortest way onto a floor tile next to its own, or onto its nearest floor tile
+	// when it is deeper in the wall, and the character with it
+	sf::Vector2f resolve(const sf::Vector2f& position, const sf::FloatRect& bounds) const
 	{
-		characterPosition = character->getPosition();
-		characterBounds = character->getGlobalBounds();
+		if (gridWidth == 0) return position;
+
+		const float right = bounds.left + bounds.width;
+		const float middle = bounds.top + bounds.height / 2;
+		const float bottom = bounds.top + bounds.height;
+		const sf::Vector2f points[4] = { sf::Vector2f(bounds.left, middle), sf::Vector2f(right, middle), sf::Vector2f(bounds.left, bottom), sf::Vector2f(right, bottom) };
+
+		sf::Vector2f shift(0.f, 0.f);
+		bool pushed = false;
+
+		for (const sf::Vector2f& corner : points)
+		{
+			const sf::Vector2f point = corner + shift;
 
-		createCollisionPoints();
+			bool inside;
+			const int32_t cell = getCell(point, inside);
+			if (inside && walkable[cell]) continue;
 
-		if (pointOutsideBounds()) {
-			character->setPosition(getNewPosition(nearestRoom));
+			// The grid has no floor at all, e.g. a hand-made level file, so there is nowhere to push to
+			if (nearestWalkable[cell] < 0) return position;
+
+			pushed = true;
+
+			sf::Vector2f push = getPushInto(point, nearestWalkable[cell]);
+			if (inside) {
+				forEachWalkableAround(cell, [&](int32_t floor) {
+					const sf::Vector2f candidate = getPushInto(point, floor);
+					if (getLengthSquared(candidate) < getLengthSquared(push)) push = candidate;
+				});
+			}
+			shift += push;
 		}
+
+		if (!pushed) return position;
+		if (fits(points, shift)) return position + shift;
+
+		// The pushes undid each other, e.g. beside a pillar one tile wide. Tries putting each point on each
+		// floor tile around it, and keeps the shortest move that fits the whole character
+		sf::Vector2f best = shift;
+		bool found = false;
+
+		for (const sf::Vector2f& point : points)
+		{
+			bool inside;
+			const int32_t cell = getCell(point, inside);
+			if (!inside) continue;
+
+			if (walkable[cell]) tryShift(points, getPushInto(point, cell), best, found);
+			forEachWalkableAround(cell, [&](int32_t floor) { tryShift(points, getPushInto(point, floor), best, found); });
+		}
+
+		return position + best;
+	}
+
+	void update(Character* character)
+	{
+		character->setPosition(resolve(character->getPosition(), character->getGlobalBounds()));
 	}
 };
\ No newline at end of file
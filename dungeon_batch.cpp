@@ -0,0 +1,275 @@
+// Headless batch generator: builds dungeons for a range of seeds on every core,
+// validates each layout and reports generation throughput.
+//
+// Usage: dungeon_batch <first seed> <count> [width] [height] [output file]
+
+#define DUNGEON_HEADLESS
+
+#include "includer.hpp"
+
+#include <atomic>
+#include <queue>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static const unsigned int batchSize = 4096;
+
+static const char batchFileMagic[4] = { 'D', 'N', 'G', 'B' };
+static const uint32_t batchFileVersion = 1;
+
+struct BatchResult {
+    double milliseconds = 0.0;
+    unsigned int roomCount = 0;
+    std::string error;
+    std::vector<char> layout;
+};
+
+uint64_t getPeakMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+template <class T>
+void writeValue(std::vector<char>& out, T value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+int findRoomIndex(const std::vector<Room*>& rooms, const Room* room)
+{
+    for (unsigned int i = 0; i < rooms.size(); i++) {
+        if (rooms[i] == room) return i;
+    }
+    return -1;
+}
+
+// Empty string if the layout is playable, otherwise the first problem found
+std::string validateDungeon(const BSPDungeon& dungeon)
+{
+    const std::vector<Room*> rooms = dungeon.getRooms();
+    const std::vector<Corridor*> corridors = dungeon.getCorridors();
+    const std::vector<Room*> chestRooms = dungeon.getChestRooms();
+
+    if (rooms.empty()) return "no rooms";
+
+    for (const Room* room : rooms) {
+        if (room->getWidth() == 0 || room->getHeight() == 0 || int(room->getWidth()) < 0 || int(room->getHeight()) < 0) return "zero-size room";
+    }
+
+    const Room* spawnRoom = dungeon.getSpawnRoom();
+    const Room* bossRoom = dungeon.getBossRoom();
+
+    if (spawnRoom == nullptr || bossRoom == nullptr) return "missing spawn or boss room";
+    if (rooms.size() > 1 && spawnRoom == bossRoom) return "spawn room is the boss room";
+
+    for (unsigned int i = 0; i < chestRooms.size(); i++) {
+        if (chestRooms[i] == spawnRoom || chestRooms[i] == bossRoom) return "chest in spawn or boss room";
+        for (unsigned int j = i + 1; j < chestRooms.size(); j++) {
+            if (chestRooms[i] == chestRooms[j]) return "two chests in one room";
+        }
+    }
+
+    // Flood fill the walkable tiles from the spawn room
+    const TileGrid& grid = dungeon.getTileGrid();
+    const int gridWidth = grid.getWidth();
+    const int gridHeight = grid.getHeight();
+
+    std::vector<uint8_t> reached(size_t(gridWidth) * gridHeight, 0);
+    std::vector<uint8_t> roomReached(rooms.size(), 0);
+
+    std::queue<size_t> open;
+    size_t start = size_t(spawnRoom->getY()) * gridWidth + spawnRoom->getX();
+    reached[start] = 1;
+    open.push(start);
+
+    while (!open.empty())
+    {
+        size_t tile = open.front();
+        open.pop();
+
+        int x = tile % gridWidth;
+        int y = tile / gridWidth;
+
+        int roomId = grid.getRoomId(x, y);
+        if (roomId >= 0) roomReached[roomId] = 1;
+
+        const int dx[4] = { 1, -1, 0, 0 };
+        const int dy[4] = { 0, 0, 1, -1 };
+
+        for (int k = 0; k < 4; k++) {
+            int nx = x + dx[k];
+            int ny = y + dy[k];
+            if (!grid.isWalkable(nx, ny)) continue;
+
+            size_t next = size_t(ny) * gridWidth + nx;
+            if (!reached[next]) {
+                reached[next] = 1;
+                open.push(next);
+            }
+        }
+    }
+
+    for (uint8_t reachedRoom : roomReached) {
+        if (!reachedRoom) return "room not reachable from spawn";
+    }
+
+    return "";
+}
+
+// Record layout: seed, size, counts, spawn/boss indices, rooms and corridors as (x, y, w, h), chest room indices
+std::vector<char> serializeDungeon(const BSPDungeon& dungeon, unsigned int width, unsigned int height)
+{
+    const std::vector<Room*> rooms = dungeon.getRooms();
+    const std::vector<Corridor*> corridors = dungeon.getCorridors();
+    const std::vector<Room*> chestRooms = dungeon.getChestRooms();
+
+    std::vector<char> out;
+    out.reserve(40 + rooms.size() * 8 + corridors.size() * 8 + chestRooms.size() * 4);
+
+    writeValue<uint64_t>(out, dungeon.getSeed());
+    writeValue<uint16_t>(out, width);
+    writeValue<uint16_t>(out, height);
+    writeValue<uint32_t>(out, rooms.size());
+    writeValue<uint32_t>(out, corridors.size());
+    writeValue<uint32_t>(out, chestRooms.size());
+    writeValue<int32_t>(out, findRoomIndex(rooms, dungeon.getSpawnRoom()));
+    writeValue<int32_t>(out, findRoomIndex(rooms, dungeon.getBossRoom()));
+
+    for (const Room* room : rooms) {
+        writeValue<uint16_t>(out, room->getX());
+        writeValue<uint16_t>(out, room->getY());
+        writeValue<uint16_t>(out, room->getWidth());
+        writeValue<uint16_t>(out, room->getHeight());
+    }
+    for (const Corridor* corridor : corridors) {
+        writeValue<uint16_t>(out, corridor->getX());
+        writeValue<uint16_t>(out, corridor->getY());
+        writeValue<uint16_t>(out, corridor->getWidth());
+        writeValue<uint16_t>(out, corridor->getHeight());
+    }
+    for (const Room* room : chestRooms) {
+        writeValue<uint32_t>(out, findRoomIndex(rooms, room));
+    }
+
+    return out;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <first seed> <count> [width] [height] [output file]" << std::endl;
+        return 2;
+    }
+
+    const uint64_t firstSeed = std::stoull(argv[1]);
+    const uint64_t count = std::stoull(argv[2]);
+    const unsigned long width = argc > 3 ? std::stoul(argv[3]) : dungeon3width;
+    const unsigned long height = argc > 4 ? std::stoul(argv[4]) : dungeon3height;
+    const std::string outputPath = argc > 5 ? argv[5] : "";
+
+    // Records store coordinates as uint16_t, margin included, so anything larger would wrap
+    const unsigned long maxSize = std::numeric_limits<uint16_t>::max() - 2 * dungeonMargin;
+    if (width > maxSize || height > maxSize) {
+        std::cerr << "Width and height must be at most " << maxSize << std::endl;
+        return 2;
+    }
+
+    std::ofstream output;
+    if (!outputPath.empty()) {
+        output.open(outputPath, std::ios::binary);
+        if (!output) {
+            std::cerr << "Failed to open " << outputPath << std::endl;
+            return 2;
+        }
+
+        uint64_t recordCount = count;
+        output.write(batchFileMagic, sizeof(batchFileMagic));
+        output.write(reinterpret_cast<const char*>(&batchFileVersion), sizeof(batchFileVersion));
+        output.write(reinterpret_cast<const char*>(&recordCount), sizeof(recordCount));
+    }
+
+    ThreadPool pool;
+
+    std::vector<double> latencies;
+    latencies.reserve(count);
+
+    uint64_t invalidCount = 0;
+    uint64_t totalRooms = 0;
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    for (uint64_t batchStart = 0; batchStart < count; batchStart += batchSize)
+    {
+        const unsigned int batchCount = unsigned(std::min<uint64_t>(batchSize, count - batchStart));
+
+        std::vector<BatchResult> results(batchCount);
+        std::atomic<unsigned int> nextIndex(0);
+
+        // One long-running task per worker, each pulling the next seed of the batch
+        std::vector<std::future<void>> tasks;
+        for (unsigned int t = 0; t < pool.getThreadCount(); t++) {
+            tasks.push_back(pool.submit([&]() {
+                for (unsigned int i = nextIndex++; i < batchCount; i = nextIndex++)
+                {
+                    BSPDungeon dungeon(width, height, firstSeed + batchStart + i);
+
+                    const auto generateStart = std::chrono::steady_clock::now();
+                    dungeon.generate();
+                    const auto generateEnd = std::chrono::steady_clock::now();
+
+                    results[i].milliseconds = std::chrono::duration<double, std::milli>(generateEnd - generateStart).count();
+                    results[i].roomCount = dungeon.getRooms().size();
+                    results[i].error = validateDungeon(dungeon);
+                    if (output.is_open()) results[i].layout = serializeDungeon(dungeon, width, height);
+                }
+            }));
+        }
+        for (std::future<void>& task : tasks) pool.wait(task);
+
+        // Written in seed order, so the output doesn't depend on the thread count
+        for (unsigned int i = 0; i < batchCount; i++)
+        {
+            latencies.push_back(results[i].milliseconds);
+
+            if (!results[i].error.empty()) {
+                if (invalidCount < 20) std::cerr << "Seed " << firstSeed + batchStart + i << ": " << results[i].error << std::endl;
+                invalidCount++;
+            }
+
+            totalRooms += results[i].roomCount;
+            if (output.is_open()) output.write(results[i].layout.data(), results[i].layout.size());
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies.empty() ? 0.0 : latencies[std::min<size_t>(latencies.size() - 1, size_t(p * latencies.size()))]; };
+
+    std::cout << "Dungeons:        " << count << " (" << width << "x" << height;
+    if (count > 0) std::cout << ", seeds " << firstSeed << ".." << firstSeed + (count - 1);
+    std::cout << ")" << std::endl;
+    std::cout << "Threads:         " << pool.getThreadCount() << std::endl;
+    std::cout << "Invalid layouts: " << invalidCount << std::endl;
+    std::cout << "Layouts/sec:     " << (seconds > 0.0 ? count / seconds : 0.0) << std::endl;
+    std::cout << "Latency p50:     " << percentile(0.50) << " ms" << std::endl;
+    std::cout << "Latency p99:     " << percentile(0.99) << " ms" << std::endl;
+    std::cout << "Peak memory:     " << getPeakMemoryBytes() / (1024.0 * 1024.0) << " MiB" << std::endl;
+    std::cout << "Rooms:           " << totalRooms << std::endl;
+    if (output.is_open()) std::cout << "Output:          " << outputPath << std::endl;
+
+    return invalidCount == 0 ? 0 : 1;
+}
@@ -40,21 +40,159 @@ private:
 		}
 	}
 
+public:
+
+	int getX() const { return x1; }
+	int getY() const { return y1; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
 	friend class BSPDungeon;
 	friend class MapRenderer;
 	friend class CollisionController;
 };
 
+enum TileType : uint8_t { voidTile, floorTile, corridorTile, wallTile };
+
+// One byte of tile type and one room id per tile, stored row by row.
+// Rooms win over corridors where they overlap, so every consumer sees the same walkable area.
+class TileGrid {
+private:
+
+	int width;
+	int height;
+
+	std::vector<uint8_t> tiles;
+	std::vector<int32_t> roomIds;
+
+	void fillRect(int x, int y, int w, int h, TileType type, int32_t roomId)
+	{
+		// Clip to the grid
+		int x0 = std::max(x, 0);
+		int y0 = std::max(y, 0);
+		int x1 = std::min(x + w, width);
+		int y1 = std::min(y + h, height);
+
+		if (x0 >= x1) return;
+
+		for (int j = y0; j < y1; j++) {
+			std::fill(tiles.begin() + size_t(j) * width + x0, tiles.begin() + size_t(j) * width + x1, type);
+			std::fill(roomIds.begin() + size_t(j) * width + x0, roomIds.begin() + size_t(j) * width + x1, roomId);
+		}
+	}
+
+	// near[i] is set when row[i] or a horizontal neighbour is walkable; walkable is scratch space of width + 2
+	void dilateRow(const uint8_t* row, uint8_t* near, uint8_t* walkable) const
+	{
+		walkable[0] = walkable[width + 1] = 0;
+		for (int i = 0; i < width; i++) walkable[i + 1] = uint8_t(row[i] - floorTile) < 2;
+		for (int i = 0; i < width; i++) near[i] = walkable[i] | walkable[i + 1] | walkable[i + 2];
+	}
+
+	void markWalls()
+	{
+		// Void tiles touching a walkable tile, diagonals included, become walls.
+		// Done as a horizontal then a vertical 3-tile dilation over three rolling rows of bytes.
+		std::vector<uint8_t> above(width, 0), same(width, 0), below(width, 0), walkable(width + 2, 0);
+
+		if (height > 0) dilateRow(&tiles[0], same.data(), walkable.data());
+
+		for (int j = 0; j < height; j++) {
+			if (j + 1 < height) dilateRow(&tiles[size_t(j + 1) * width], below.data(), walkable.data());
+			else std::fill(below.begin(), below.end(), 0);
+
+			uint8_t* row = &tiles[size_t(j) * width];
+			for (int i = 0; i < width; i++) {
+				uint8_t nearFloor = above[i] | same[i] | below[i];
+				row[i] = (row[i] == voidTile && nearFloor) ? uint8_t(wallTile) : row[i];
+			}
+
+			std::swap(above, same);
+			std::swap(same, below);
+		}
+	}
+
+public:
+
+	TileGrid() : width(0), height(0) {}
+
+	void build(int _width, int _height, const std::vector<Room*>& rooms, const std::vector<Corridor*>& corridors)
+	{
+		width = _width;
+		height = _height;
+
+		tiles.assign(size_t(width) * height, voidTile);
+		roomIds.assign(size_t(width) * height, -1);
+
+		for (const Corridor* corridor : corridors) {
+			fillRect(corridor->getX(), corridor->getY(), corridor->getWidth(), corridor->getHeight(), corridorTile, -1);
+		}
+
+		// Rooms are filled last so they win over corridors
+		for (unsigned int i = 0; i < rooms.size(); i++) {
+			fillRect(rooms[i]->getX(), rooms[i]->getY(), rooms[i]->getWidth(), rooms[i]->getHeight(), floorTile, i);
+		}
+
+		markWalls();
+	}
+
+	void clear()
+	{
+		width = height = 0;
+		tiles.clear();
+		roomIds.clear();
+	}
+
+	int getWidth() const { return width; }
+
+	int getHeight() const { return height; }
+
+	bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+	// Anything outside the grid is void
+	TileType getTile(int x, int y) const { return contains(x, y) ? TileType(tiles[size_t(y) * width + x]) : voidTile; }
+
+	bool isWalkable(int x, int y) const
+	{
+		TileType tile = getTile(x, y);
+		return tile == floorTile || tile == corridorTile;
+	}
+
+	// Index into BSPDungeon::getRooms(), -1 outside rooms
+	int getRoomId(int x, int y) const { return contains(x, y) ? roomIds[size_t(y) * width + x] : -1; }
+
+	// Raw rows for sweeps, width entries each
+	const uint8_t* getTileRow(int y) const { return &tiles[size_t(y) * width]; }
+
+	const int32_t* getRoomIdRow(int y) const { return &roomIds[size_t(y) * width]; }
+};
+
 class Node {
 private:
 
 	int x, y, width, height;
 
-	Node* left;
-	Node* right;
-	Room* room;
+	// Indices into BSPDungeon::nodes, -1 for a leaf
+	int left;
+	int right;
+
+	// Leaves of the subtree are stored contiguously in BSPDungeon::leaves
+	int firstLeaf;
+	int leafCount;
+
+	// Index into BSPDungeon::corridors of the corridor joining the children, -1 for a leaf
+	int corridor;
+
+	// Seeds every random choice made for this node
+	uint64_t key;
+
+	Node(int _x, int _y, int _width, int _height, uint64_t _key) : x(_x), y(_y), width(_width), height(_height), left(-1), right(-1), firstLeaf(0), leafCount(1), corridor(-1), key(_key) {}
+
+	bool isLeaf() const { return left < 0 || right < 0; }
+
+	bool contains(int _x, int _y) const { return _x >= x && _x < x + width && _y >= y && _y < y + height; }
 
-	Node(int _x, int _y, int _width, int _height) : x(_x), y(_y), width(_width), height(_height), left(nullptr), right(nullptr), room(nullptr) {}
+	bool intersects(const sf::IntRect& area) const { return x < area.left + area.width && area.left < x + width && y < area.top + area.height && area.top < y + height; }
 
 	friend class BSPDungeon;
 };
@@ -62,56 +200,91 @@ private:
 class BSPDungeon {
 private:
 
-	Node* root;
-
 	int width;
 	int height;
 
+	uint64_t seed;
+	RandomGenerator random;
+
+	// Whole tree in one array in depth-first order, root at index 0
+	std::vector<Node> nodes;
+	std::vector<int> leaves;
+
+	// Room i belongs to leaf i
+	std::vector<Room> roomStorage;
+	std::vector<Corridor> corridorStorage;
+
 	std::vector<Room*> rooms;
 	std::vector<Corridor*> corridors;
 
 	Room* spawnRoom = nullptr;
 	Room* bossRoom = nullptr;
 	std::vector<Room*> chestRooms;
-	bool chestRoom = false;
 
-	void splitNode(Node* node);
+	TileGrid tileGrid;
+
+	// Flat copies of the level handed out through getLayout()
+	std::vector<LevelRect> roomRects;
+	std::vector<LevelRect> corridorRects;
+	std::vector<uint32_t> chestRoomIndices;
+	LevelLayout layout;
+
+	void buildLayout();
+
+	// Nodes in depth-first order with right children as offsets from their parent, so a subtree can be appended anywhere as is
+	struct SubTree {
+		std::vector<Node> nodes;
+		std::vector<Room> rooms;
+	};
+
+	void generateTree(ThreadPool* pool);
+
+	void buildSubtree(const Node& node, SubTree& tree, ThreadPool* pool) const;
+
+	bool splitNode(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const;
 
-	void splitHorizontal(Node* node);
+	void splitHorizontal(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const;
 
-	void splitVertical(Node* node);
+	void splitVertical(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const;
 
-	void deleteNode(Node* node);
+	Room generateRoom(const Node& node, SplitMixGenerator& nodeRandom) const;
 
-	void generateRooms(Node* node);
+	void generateCorridors();
 
-	void generateCorridors(Node* node);
+	void pickSpawnRoom(int index);
 
-	void pickSpawnRoom(Node* node);
+	void pickBossRoom(int index, const bool& pick);
 
-	void pickBossRoom(Node* node, const bool& pick);
+	void pickChestRoom(int index);
 
-	void pickChestRoom(Node* node);
+	Room* getLeafRoom(int index) { return &roomStorage[nodes[index].firstLeaf]; }
 
 	void reset() 
 	{
-		deleteNode(root);
-		for (auto corridor : corridors) delete corridor;
+		nodes.clear();
+		leaves.clear();
+		roomStorage.clear();
+		corridorStorage.clear();
 		rooms.clear();
 		corridors.clear();
 		chestRooms.clear();
+		tileGrid.clear();
+		roomRects.clear();
+		corridorRects.clear();
+		chestRoomIndices.clear();
+		layout = LevelLayout();
 		spawnRoom = nullptr; 
 		bossRoom = nullptr;
-		root = nullptr;
 	}
 
 public:
 
-	BSPDungeon(int _width, int _height) : width(_width), height(_height), root(nullptr) {}
+	BSPDungeon(int _width, int _height, uint64_t _seed) : width(_width), height(_height), seed(_seed), random(_seed) {}
 
-	~BSPDungeon() { reset(); }
+	// Subtrees are built on the pool when one is given; the result is the same as a serial run
+	void generate(ThreadPool* pool = nullptr);
 
-	void generate();
+	uint64_t getSeed() const { return seed; }
 
 	std::vector<Room*> getRooms() const { return rooms; }
 
@@ -123,185 +296,352 @@ public:
 
 	std::vector<Room*> getChestRooms() const { return chestRooms; }
 
+	// Covers the whole map including the margin around the dungeon, in tile coordinates
+	const TileGrid& getTileGrid() const { return tileGrid; }
+
+	// Valid until the next generate() or until the dungeon is destroyed
+	const LevelLayout& getLayout() const { return layout; }
+
 	sf::Vector2f getStartingPosition() const { return sf::Vector2f((spawnRoom->x + spawnRoom->width / 2) * tileSize.x, (spawnRoom->y + spawnRoom->height / 2) * tileSize.y); }
+
+	// Spatial queries in tile coordinates, walking down the tree in O(depth)
+
+	int findLeaf(int x, int y) const;
+
+	Room* getRoomAt(int x, int y) const;
+
+	void queryRooms(const sf::IntRect& area, std::vector<Room*>& result) const;
+
+	void queryCorridors(const sf::IntRect& area, std::vector<Corridor*>& result) const;
 };
 
-void BSPDungeon::generate() 
+void BSPDungeon::generate(ThreadPool* pool) 
 {
 	reset();
 
-	root = new Node(20, 20, width, height);
+	// Restart the layout stream so generate() always rebuilds the same level for the same seed
+	random.setSeed(seed);
+
+	generateTree(pool);
+	generateCorridors();
+
+	tileGrid.build(width + 2 * dungeonMargin, height + 2 * dungeonMargin, rooms, corridors);
 
-	splitNode(root);
-	generateRooms(root);
-	generateCorridors(root);
+	const Node& root = nodes[0];
 
-	bool pick = getRandomInRange(0, 100) < 50;
-	if (getRandomInRange(0, 100) < 50) {
-		pickSpawnRoom(root->left);
-		pickBossRoom(root->right, pick);
+	if (root.isLeaf()) {
+		spawnRoom = bossRoom = getLeafRoom(0);
+		buildLayout();
+		return;
+	}
+
+	bool pick = random.getInRange(layoutStream, 0, 100) < 50;
+	if (random.getInRange(layoutStream, 0, 100) < 50) {
+		pickSpawnRoom(root.left);
+		pickBossRoom(root.right, pick);
 	}
 	else {
-		pickSpawnRoom(root->right);
-		pickBossRoom(root->left, pick);
+		pickSpawnRoom(root.right);
+		pickBossRoom(root.left, pick);
 	}
 
-	chestRoom = false;
+	pickChestRoom(root.left);
+	pickChestRoom(root.right);
+
+	buildLayout();
+}
+
+void BSPDungeon::buildLayout()
+{
+	roomRects.reserve(roomStorage.size());
+	for (const Room& room : roomStorage) {
+		roomRects.push_back({ int32_t(room.x), int32_t(room.y), int32_t(room.width), int32_t(room.height) });
+	}
 
-	pickChestRoom(root->left);
+	corridorRects.reserve(corridorStorage.size());
+	for (const Corridor& corridor : corridorStorage) {
+		corridorRects.push_back({ corridor.x1, corridor.y1, corridor.width, corridor.height });
+	}
 
-	chestRoom = false;
+	for (const Room* room : chestRooms) {
+		chestRoomIndices.push_back(room - roomStorage.data());
+	}
 
-	pickChestRoom(root->right);
+	layout.seed = seed;
+	layout.rooms = roomRects.data();
+	layout.roomCount = roomRects.size();
+	layout.corridors = corridorRects.data();
+	layout.corridorCount = corridorRects.size();
+	layout.chestRooms = chestRoomIndices.data();
+	layout.chestRoomCount = chestRoomIndices.size();
+	layout.spawnRoom = spawnRoom - roomStorage.data();
+	layout.bossRoom = bossRoom - roomStorage.data();
+	layout.tiles = tileGrid.getTileRow(0);
+	layout.roomIds = tileGrid.getRoomIdRow(0);
+	layout.gridWidth = tileGrid.getWidth();
+	layout.gridHeight = tileGrid.getHeight();
 }
 
-void BSPDungeon::splitNode(Node* node) 
+void BSPDungeon::generateTree(ThreadPool* pool)
 {
-	if (node == nullptr) return;
+	SubTree tree;
+	buildSubtree(Node(dungeonMargin, dungeonMargin, width, height, random.getStreamSeed(layoutStream)), tree, pool);
+
+	nodes = std::move(tree.nodes);
+	roomStorage = std::move(tree.rooms);
+
+	// Turn the relative child offsets into indices, and list the leaves in depth-first order
+	for (int index = 0; index < int(nodes.size()); index++) 
+	{
+		Node& node = nodes[index];
+		if (node.isLeaf()) {
+			node.firstLeaf = leaves.size();
+			leaves.push_back(index);
+		}
+		else {
+			node.left += index;
+			node.right += index;
+		}
+	}
+
+	// Children always come after their parent, so one backwards pass sums the leaf ranges
+	for (int index = nodes.size() - 1; index >= 0; index--) 
+	{
+		Node& node = nodes[index];
+		if (node.isLeaf()) continue;
+		node.firstLeaf = nodes[node.left].firstLeaf;
+		node.leafCount = nodes[node.left].leafCount + nodes[node.right].leafCount;
+	}
 
+	rooms.reserve(roomStorage.size());
+	for (Room& room : roomStorage) rooms.push_back(&room);
+}
+
+void BSPDungeon::buildSubtree(const Node& node, SubTree& tree, ThreadPool* pool) const
+{
+	const int index = tree.nodes.size();
+	tree.nodes.push_back(node);
+
+	// Every random choice for this node comes from its own key, so the result doesn't depend on which thread builds it or when
+	SplitMixGenerator nodeRandom(node.key);
+
+	Node left(0, 0, 0, 0, splitMix64(node.key + 1));
+	Node right(0, 0, 0, 0, splitMix64(node.key + 2));
+
+	if (!splitNode(node, nodeRandom, left, right)) {
+		tree.rooms.push_back(generateRoom(node, nodeRandom));
+		return;
+	}
+
+	// Left child directly follows its parent, right child follows the whole left subtree
+	tree.nodes[index].left = 1;
+
+	if (pool != nullptr && unsigned(node.width * node.height) >= parallelSplitMinArea) {
+		SubTree rightTree;
+		std::future<void> rightTask = pool->submit([this, &right, &rightTree, pool]() { buildSubtree(right, rightTree, pool); });
+
+		buildSubtree(left, tree, pool);
+		pool->wait(rightTask);
+
+		tree.nodes[index].right = tree.nodes.size() - index;
+		tree.nodes.insert(tree.nodes.end(), rightTree.nodes.begin(), rightTree.nodes.end());
+		tree.rooms.insert(tree.rooms.end(), rightTree.rooms.begin(), rightTree.rooms.end());
+	}
+	else {
+		buildSubtree(left, tree, pool);
+		tree.nodes[index].right = tree.nodes.size() - index;
+		buildSubtree(right, tree, pool);
+	}
+}
+
+bool BSPDungeon::splitNode(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const
+{
 	// Randomly pick split direction
-	bool splitHorizontally = getRandomInRange(0, 100) < 50;
+	bool splitHorizontally = nodeRandom.getInRange(0, 100) < 50;
 
 	if (splitHorizontally) {
 		// Split if there is enough space for two subdungeons
-		if (node->height > 2 * maxRoomSize) {
-			splitHorizontal(node);
+		if (node.height > 2 * maxRoomSize) {
+			splitHorizontal(node, nodeRandom, left, right);
 		}
-		else if (node->width > 2 * minRoomSize) {
-			splitVertical(node);
+		else if (node.width > 2 * minRoomSize) {
+			splitVertical(node, nodeRandom, left, right);
 		}
-		else return;
+		else return false;
 	}
 	else {
-		if (node->width > 2 * maxRoomSize) {
-			splitVertical(node);
+		if (node.width > 2 * maxRoomSize) {
+			splitVertical(node, nodeRandom, left, right);
 		}
-		else if (node->height > 2 * minRoomSize) {
-			splitHorizontal(node);
+		else if (node.height > 2 * minRoomSize) {
+			splitHorizontal(node, nodeRandom, left, right);
 		}
-		else return;
+		else return false;
 	}
 
-	splitNode(node->left);
-	splitNode(node->right);
+	return true;
 }
 
-void BSPDungeon::deleteNode(Node* node) 
+void BSPDungeon::splitHorizontal(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const
 {
-	if (node == nullptr) return;
-	deleteNode(node->left);
-	deleteNode(node->right);
-	delete node->room;
-	node->room = nullptr;
-	delete node;
+	int maxSize = node.height - minRoomSize;
+	int h1 = nodeRandom.getInRange(minRoomSize, maxSize);
+	int h2 = node.height - h1;
+	left = Node(node.x, node.y, node.width, h1, left.key);
+	right = Node(node.x, node.y + h1, node.width, h2, right.key);
 }
 
-void BSPDungeon::splitHorizontal(Node* node) 
+void BSPDungeon::splitVertical(const Node& node, SplitMixGenerator& nodeRandom, Node& left, Node& right) const
 {
-	int maxSize = node->height - minRoomSize;
-	int h1 = getRandomInRange(minRoomSize, maxSize);
-	int h2 = node->height - h1;
-	node->left = new Node(node->x, node->y, node->width, h1);
-	node->right = new Node(node->x, node->y + node->left->height, node->width, h2);
+	int maxSize = node.width - minRoomSize;
+	int w1 = nodeRandom.getInRange(minRoomSize, maxSize);
+	int w2 = node.width - w1;
+	left = Node(node.x, node.y, w1, node.height, left.key);
+	right = Node(node.x + w1, node.y, w2, node.height, right.key);
 }
 
-void BSPDungeon::splitVertical(Node* node) 
+Room BSPDungeon::generateRoom(const Node& node, SplitMixGenerator& nodeRandom) const
 {
-	int maxSize = node->width - minRoomSize;
-	int w1 = getRandomInRange(minRoomSize, maxSize);
-	int w2 = node->width - w1;
-	node->left = new Node(node->x, node->y, w1, node->height);
-	node->right = new Node(node->x + node->left->width, node->y, w2, node->height);
+	// Choose random position for a room within corresponding subdungeon
+	int x = node.x + nodeRandom.getInRange(roomMargin, node.width / 3);
+	int y = node.y + nodeRandom.getInRange(roomMargin, node.height / 3);
+
+	// Calculate room dimensions based on the position
+	int w = node.width - (x - node.x);
+	int h = node.height - (y - node.y);
+	w -= nodeRandom.getInRange(roomMargin, w / 3);
+	h -= nodeRandom.getInRange(roomMargin, h / 3);
+
+	return Room(x, y, w, h);
 }
 
-void BSPDungeon::generateRooms(Node* node)
+void BSPDungeon::generateCorridors() 
 {
-	if (node == nullptr) return;
+	corridorStorage.reserve(nodes.size() - leaves.size());
+	corridors.reserve(nodes.size() - leaves.size());
 
-	if (node->left == nullptr || node->right == nullptr) {
-		// Choose random position for a room within corresponding subdungeon
-		int x = node->x + getRandomInRange(roomMargin, node->width / 3);
-		int y = node->y + getRandomInRange(roomMargin, node->height / 3);
+	// Nodes are stored parent first, then the left subtree, then the right one, so walking the array
+	// emits corridors in the same pre-order as the recursive generator did. Keep it that way, anything
+	// indexing corridors relies on the order
+	for (Node& node : nodes) 
+	{
+		if (node.isLeaf()) continue;
 
-		// Calculate room dimensions based on the position
-		int w = node->width - (x - node->x);
-		int h = node->height - (y - node->y);
-		w -= getRandomInRange(roomMargin, w / 3);
-		h -= getRandomInRange(roomMargin, h / 3);
+		const Node& left = nodes[node.left];
+		const Node& right = nodes[node.right];
 
-		node->room = new Room(x, y, w, h);
-		rooms.push_back(node->room);
-		return;
-	}
+		int start_x = left.x + (left.width / 2);
+		int start_y = left.y + (left.height / 2);
+		int end_x = right.x + (right.width / 2);
+		int end_y = right.y + (right.height / 2);
 
-	generateRooms(node->left);
-	generateRooms(node->right);
+		node.corridor = corridorStorage.size();
+		corridorStorage.push_back(Corridor(start_x, start_y, end_x, end_y));
+		corridors.push_back(&corridorStorage.back());
+	}
 }
 
-void BSPDungeon::generateCorridors(Node* node) 
+void BSPDungeon::pickSpawnRoom(int index) 
 {
-	if (node->left == nullptr || node->right == nullptr) return;
+	while (!nodes[index].isLeaf()) 
+	{
+		bool pickLeft = random.getInRange(layoutStream, 0, 100) < 50;
+		index = pickLeft ? nodes[index].left : nodes[index].right;
+	}
 
-	int start_x = node->left->x + (node->left->width / 2);
-	int start_y = node->left->y + (node->left->height / 2);
-	int end_x = node->right->x + (node->right->width / 2);
-	int end_y = node->right->y + (node->right->height / 2);
+	spawnRoom = getLeafRoom(index);
+}
 
-	corridors.push_back(new Corridor(start_x, start_y, end_x, end_y));
+void BSPDungeon::pickBossRoom(int index, const bool& pick) 
+{
+	while (!nodes[index].isLeaf()) {
+		index = pick ? nodes[index].left : nodes[index].right;
+	}
 
-	generateCorridors(node->left);
-	generateCorridors(node->right);
+	bossRoom = getLeafRoom(index);
 }
 
-void BSPDungeon::pickSpawnRoom(Node* node) 
+void BSPDungeon::pickChestRoom(int index) 
 {
-	if (spawnRoom != nullptr) return;
+	// First room of the subtree, in depth-first order, that is neither the spawn nor the boss room
+	const Node& node = nodes[index];
 
-	if (node->left == nullptr || node->right == nullptr) {
-		spawnRoom = node->room;
-		return;
+	for (int leaf = node.firstLeaf; leaf < node.firstLeaf + node.leafCount; leaf++) 
+	{
+		Room* room = &roomStorage[leaf];
+		if (room != bossRoom && room != spawnRoom) {
+			chestRooms.push_back(room);
+			return;
+		}
 	}
+}
 
-	bool pickLeft = getRandomInRange(0, 100) < 50;
+int BSPDungeon::findLeaf(int x, int y) const
+{
+	if (nodes.empty() || !nodes[0].contains(x, y)) return -1;
 
-	if (pickLeft) {
-		pickSpawnRoom(node->left);
-	}
-	else {
-		pickSpawnRoom(node->right);
+	int index = 0;
+	while (!nodes[index].isLeaf()) {
+		index = nodes[nodes[index].left].contains(x, y) ? nodes[index].left : nodes[index].right;
 	}
+
+	return index;
 }
 
-void BSPDungeon::pickBossRoom(Node* node, const bool& pick) 
+Room* BSPDungeon::getRoomAt(int x, int y) const
 {
-	if (bossRoom != nullptr) return;
+	int index = findLeaf(x, y);
+	if (index < 0) return nullptr;
 
-	if (node->left == nullptr || node->right == nullptr) {
-		bossRoom = node->room;
-		return;
-	}
+	Room* room = rooms[nodes[index].firstLeaf];
+	if (int(room->x) <= x && x < int(room->x + room->width) && int(room->y) <= y && y < int(room->y + room->height)) return room;
 
-	if (pick) {
-		pickBossRoom(node->left, pick);
-	}
-	else {
-		pickBossRoom(node->right, pick);
-	}
+	return nullptr;
 }
 
-void BSPDungeon::pickChestRoom(Node* node) 
+void BSPDungeon::queryRooms(const sf::IntRect& area, std::vector<Room*>& result) const
 {
-	if (chestRoom) return;
+	if (nodes.empty()) return;
+
+	// A room never leaves its partition, so subtrees whose partition misses the area are skipped
+	std::vector<int> stack(1, 0);
 
-	if (node->left == nullptr || node->right == nullptr) 
+	while (!stack.empty()) 
 	{
-		if (node->room != bossRoom && node->room != spawnRoom) {
-			chestRooms.push_back(node->room);
-			chestRoom = true;
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!node.intersects(area)) continue;
+
+		if (node.isLeaf()) {
+			Room* room = rooms[node.firstLeaf];
+			if (sf::IntRect(room->x, room->y, room->width, room->height).intersects(area)) result.push_back(room);
+		}
+		else {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
 		}
-		return;
 	}
+}
+
+void BSPDungeon::queryCorridors(const sf::IntRect& area, std::vector<Corridor*>& result) const
+{
+	if (nodes.empty()) return;
 
-	pickChestRoom(node->left);
-	pickChestRoom(node->right);
+	// A corridor runs between the centres of its node's children, so it never leaves that node's partition either
+	std::vector<int> stack(1, 0);
+
+	while (!stack.empty()) 
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.isLeaf() || !node.intersects(area)) continue;
+
+		Corridor* corridor = corridors[node.corridor];
+		if (sf::IntRect(corridor->x1, corridor->y1, corridor->width, corridor->height).intersects(area)) result.push_back(corridor);
+
+		stack.push_back(node.right);
+		stack.push_back(node.left);
+	}
 }
\ No newline at end of file
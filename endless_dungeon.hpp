@@ -0,0 +1,275 @@
+#pragma once
+
+// Every border between two sectors has one door, owned by the sector west or north of it
+enum SectorEdge { eastEdge, southEdge };
+
+class Sector {
+private:
+
+	int64_t x, y;
+	uint64_t seed;
+
+	// Tile coordinates local to the sector
+	std::vector<LevelRect> rooms;
+	std::vector<LevelRect> corridors;
+	LevelLayout layout;
+
+	MapRenderer map;
+	BackgroundRenderer background;
+
+	friend class EndlessDungeon;
+};
+
+// Streams sectors in around the player and drops them once they are far behind, so memory and
+// per-frame work stay the same however far the player walks. Positions are kept relative to an
+// origin sector that is moved to the player from time to time.
+class EndlessDungeon {
+private:
+
+	uint64_t seed;
+
+	// Shared by the renderers of every sector, through the texture cache
+	TextureHandle tileset;
+	TextureHandle backgroundTileset;
+
+	std::map<std::pair<int64_t, int64_t>, Sector*> sectors;
+
+	// Sector drawn at pixel (0, 0), and the sector the player was last seen in
+	int64_t originX, originY;
+	int64_t centerX, centerY;
+	bool started;
+
+	uint64_t getSectorKey(int64_t sectorX, int64_t sectorY, uint64_t salt) const
+	{
+		return splitMix64(splitMix64(splitMix64(seed + salt) + uint64_t(sectorX)) + uint64_t(sectorY));
+	}
+
+	// Both sectors sharing the border derive the same offset without either one being loaded
+	int getDoorOffset(int64_t sectorX, int64_t sectorY, SectorEdge edge) const
+	{
+		SplitMixGenerator doorRandom(getSectorKey(sectorX, sectorY, edge + 1));
+		return doorRandom.getInRange(sectorPadding, sectorSize - sectorPadding - corridorWidth);
+	}
+
+	// L-shaped corridor from a door on the border to the centre of the nearest room
+	void connectDoor(Sector& sector, int border, int door, bool horizontal)
+	{
+		const int doorX = horizontal ? border : door;
+		const int doorY = horizontal ? door : border;
+
+		const LevelRect* nearest = &sector.rooms[0];
+		int64_t nearestDistance = std::numeric_limits<int64_t>::max();
+
+		for (const LevelRect& room : sector.rooms) {
+			int64_t dx = room.x + room.width / 2 - doorX;
+			int64_t dy = room.y + room.height / 2 - doorY;
+			if (dx * dx + dy * dy < nearestDistance) {
+				nearestDistance = dx * dx + dy * dy;
+				nearest = &room;
+			}
+		}
+
+		const int centerX = nearest->x + nearest->width / 2;
+		const int centerY = nearest->y + nearest->height / 2;
+
+		if (horizontal) {
+			int left = std::min(border, centerX);
+			int right = std::max(border, centerX + int(corridorWidth));
+			int top = std::min(door, centerY);
+			int bottom = std::max(door, centerY) + corridorWidth;
+
+			sector.corridors.push_back({ left, door, right - left, int32_t(corridorWidth) });
+			sector.corridors.push_back({ centerX, top, int32_t(corridorWidth), bottom - top });
+		}
+		else {
+			int top = std::min(border, centerY);
+			int bottom = std::max(border, centerY + int(corridorWidth));
+			int left = std::min(door, centerX);
+			int right = std::max(door, centerX) + corridorWidth;
+
+			sector.corridors.push_back({ door, top, int32_t(corridorWidth), bottom - top });
+			sector.corridors.push_back({ left, centerY, right - left, int32_t(corridorWidth) });
+		}
+	}
+
+	Sector* generateSector(int64_t sectorX, int64_t sectorY, EnemyController* enemyController)
+	{
+		Sector* sector = new Sector;
+		sector->x = sectorX;
+		sector->y = sectorY;
+		sector->seed = getSectorKey(sectorX, sectorY, 0);
+
+		BSPDungeon dungeon(sectorSize - 2 * sectorPadding, sectorSize - 2 * sectorPadding, sector->seed);
+		dungeon.generate();
+
+		// The generator leaves dungeonMargin empty tiles around the rooms, sectors only sectorPadding
+		const LevelLayout& level = dungeon.getLayout();
+		const int shift = int(sectorPadding) - int(dungeonMargin);
+
+		sector->rooms.reserve(level.roomCount);
+		for (uint32_t i = 0; i < level.roomCount; i++) {
+			const LevelRect& room = level.rooms[i];
+			sector->rooms.push_back({ room.x + shift, room.y + shift, room.width, room.height });
+		}
+
+		sector->corridors.reserve(level.corridorCount + 8);
+		for (uint32_t i = 0; i < level.corridorCount; i++) {
+			const LevelRect& corridor = level.corridors[i];
+			sector->corridors.push_back({ corridor.x + shift, corridor.y + shift, corridor.width, corridor.height });
+		}
+
+		// Doors on all four borders stitch the sector to its neighbours
+		connectDoor(*sector, sectorSize, getDoorOffset(sectorX, sectorY, eastEdge), true);
+		connectDoor(*sector, 0, getDoorOffset(sectorX - 1, sectorY, eastEdge), true);
+		connectDoor(*sector, sectorSize, getDoorOffset(sectorX, sectorY, southEdge), false);
+		connectDoor(*sector, 0, getDoorOffset(sectorX, sectorY - 1, southEdge), false);
+
+		LevelLayout& layout = sector->layout;
+		layout.seed = sector->seed;
+		layout.rooms = sector->rooms.data();
+		layout.roomCount = sector->rooms.size();
+		layout.corridors = sector->corridors.data();
+		layout.corridorCount = sector->corridors.size();
+		layout.spawnRoom = level.spawnRoom;
+
+		RandomGenerator sectorRandom(sector->seed);
+
+		sector->map.setTileset(tileset);
+		sector->map.build(tileSize, layout, sectorRandom.getStreamSeed(tileStream));
+		sector->background.setTileset(backgroundTileset);
+		sector->background.build(tileSize, sectorSize, sectorSize, sectorRandom.getStreamSeed(backgroundStream));
+
+		enemyController->spawnSectorEnemies(layout, getSectorPosition(sectorX, sectorY), sectorRandom);
+
+		return sector;
+	}
+
+	sf::Vector2f getSectorPosition(int64_t sectorX, int64_t sectorY) const
+	{
+		return sf::Vector2f(float((sectorX - originX) * int64_t(sectorSize * tileSize.x)), float((sectorY - originY) * int64_t(sectorSize * tileSize.y)));
+	}
+
+	// Everything within the evict radius of the player's sector, in pixels
+	sf::FloatRect getKeptArea() const
+	{
+		const sf::Vector2f size(float((2 * sectorEvictRadius + 1) * sectorSize * tileSize.x), float((2 * sectorEvictRadius + 1) * sectorSize * tileSize.y));
+		return sf::FloatRect(getSectorPosition(centerX - sectorEvictRadius, centerY - sectorEvictRadius), size);
+	}
+
+	void reset()
+	{
+		for (auto& entry : sectors) {
+			delete entry.second;
+		}
+		sectors.clear();
+	}
+
+public:
+
+	EndlessDungeon(uint64_t _seed) : seed(_seed), originX(0), originY(0), centerX(0), centerY(0), started(false) {}
+
+	~EndlessDungeon()
+	{
+		reset();
+	}
+
+	void setTilesets(const TextureHandle& dungeonTileset, const TextureHandle& background)
+	{
+		tileset = dungeonTileset;
+		backgroundTileset = background;
+	}
+
+	// Places the player in the spawn room of the first sector and streams in its surroundings
+	void start(PlayerCharacter* player, CollisionController* collisionController, EnemyController* enemyController, ItemContainer* itemContainer)
+	{
+		reset();
+		originX = originY = 0;
+		started = false;
+
+		Sector* first = generateSector(0, 0, enemyController);
+		sectors[std::make_pair(int64_t(0), int64_t(0))] = first;
+
+		player->setPosition(first->layout.getStartingPosition());
+
+		update(player, collisionController, enemyController, itemContainer);
+	}
+
+	// Does nothing until the player crosses into another sector
+	void update(PlayerCharacter* player, CollisionController* collisionController, EnemyController* enemyController, ItemContainer* itemContainer)
+	{
+		const sf::Vector2f position = player->getPosition();
+		const int64_t playerX = originX + int64_t(std::floor(position.x / float(sectorSize * tileSize.x)));
+		const int64_t playerY = originY + int64_t(std::floor(position.y / float(sectorSize * tileSize.y)));
+
+		if (started && playerX == centerX && playerY == centerY) return;
+
+		started = true;
+		centerX = playerX;
+		centerY = playerY;
+
+		// Move the origin to the player, and everything in the world with it
+		if (std::abs(centerX - originX) > int64_t(sectorRebaseDistance) || std::abs(centerY - originY) > int64_t(sectorRebaseDistance)) {
+			const sf::Vector2f shift = -getSectorPosition(centerX, centerY);
+			originX = centerX;
+			originY = centerY;
+
+			player->setPosition(position + shift);
+			enemyController->translate(shift);
+			itemContainer->translate(shift);
+		}
+
+		auto it = sectors.begin();
+		while (it != sectors.end())
+		{
+			const Sector* sector = it->second;
+			if (std::max(std::abs(sector->x - centerX), std::abs(sector->y - centerY)) > int64_t(sectorEvictRadius)) {
+				delete sector;
+				it = sectors.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		const int64_t radius = sectorLoadRadius;
+		for (int64_t y = centerY - radius; y <= centerY + radius; y++) {
+			for (int64_t x = centerX - radius; x <= centerX + radius; x++) {
+				Sector*& sector = sectors[std::make_pair(x, y)];
+				if (sector == nullptr) sector = generateSector(x, y, enemyController);
+			}
+		}
+
+		enemyController->removeOutside(getKeptArea());
+		itemContainer->removeOutside(getKeptArea());
+
+		// Rebuilt whole rather than per sector: at most (2 * sectorEvictRadius + 1)^2 sectors are kept, so the
+		// hitch on entering a sector stays around a millisecond however far the player walks
+		collisionController->clear();
+		for (auto& entry : sectors) {
+			Sector* sector = entry.second;
+			const sf::Vector2f offset = getSectorPosition(sector->x, sector->y);
+
+			sector->map.setPosition(offset);
+			sector->background.setPosition(offset);
+			collisionController->addLevel(sector->layout, offset);
+		}
+		collisionController->build();
+	}
+
+	// Only sectors overlapping the view are drawn
+	void draw(sf::RenderTarget& target, const sf::View& view) const
+	{
+		const sf::FloatRect visible(view.getCenter() - view.getSize() / 2.f, view.getSize());
+		const sf::Vector2f size(float(sectorSize * tileSize.x), float(sectorSize * tileSize.y));
+
+		for (auto& entry : sectors) {
+			const Sector* sector = entry.second;
+			if (!visible.intersects(sf::FloatRect(getSectorPosition(sector->x, sector->y), size))) continue;
+
+			target.draw(sector->background);
+			target.draw(sector->map);
+		}
+	}
+
+	unsigned int getSectorCount() const { return sectors.size(); }
+};
\ No newline at end of file
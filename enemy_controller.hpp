@@ -3,210 +3,189 @@
 class EnemyController {
 private:
 
-	std::vector<EnemyCharacter*> activeEnemies;
+	// Every enemy of the level, the boss included
+	EnemyStore enemies;
 
-	std::map<unsigned int, std::string> enemyContainer;
+	EnemySet enemySet;
 
-	std::string bossAnimPath;
+	// Empty without a boss
+	SlotHandle boss;
 
-	EnemyCharacter* boss;
+	// Clips of each tier, the boss being tier 0. Looked up on the first spawn of the tier, so spawning
+	// more enemies builds no paths
+	const AnimationClip* idleClips[5];
+	const AnimationClip* runClips[5];
 
-	int convertDirectoryNameToInt(const std::string& directoryName) 
+	// Scratch for applyDamage(), enemies the weapon hit
+	std::vector<std::size_t> hits;
+
+	RandomGenerator* random;
+	AnimationSystem* animations;
+
+	// Set once the controller is in play, levels are prepared before there is anything to draw
+	RenderQueue* renderQueue;
+
+	void loadClips(unsigned int tier)
 	{
-		try {
-			return std::stoi(directoryName);
-		}
-		catch (const std::exception& e) {
-			// Handle conversion error
-			throw std::runtime_error("Failed to convert directory name to int: " + std::string(e.what()));
-		}
+		if (idleClips[tier] != nullptr) return;
+
+		const std::string& directory = tier == 0 ? enemySet.boss : enemySet.tiers.at(tier);
+		idleClips[tier] = animations->getClip(directory + "/idle", 4, 0.1f, true);
+		runClips[tier] = animations->getClip(directory + "/run", 4, 0.1f, true);
 	}
 
-	void createEnemies(unsigned int room_capacity, const Room* room)
+	void createEnemies(unsigned int room_capacity, const LevelRect& room, const sf::Vector2f& offset, RandomGenerator& spawnRandom)
 	{
 		unsigned int index = 0;
 		
 		while (index <= room_capacity)
 		{
-			unsigned int enemyTier = getRandomInRange(0, 100);
+			unsigned int enemyTier = spawnRandom.getInRange(spawnStream, 0, 100);
 
-			if (enemyTier < tier1EnemyChance) {
-				activeEnemies.push_back(new EnemyCharacter(enemyContainer.at(1) + "/idle", enemyContainer.at(1) + "/run", tier1EnemyMvSpeed, tier1EnemyHP));
-				index += 1;
-			}
-			else if (enemyTier < tier2EnemyChance + tier1EnemyChance) {
-				activeEnemies.push_back(new EnemyCharacter(enemyContainer.at(2) + "/idle", enemyContainer.at(2) + "/run", tier2EnemyMvSpeed, tier2EnemyHP));
-				index += 2;
-			}
-			else if (enemyTier < tier3EnemyChance + tier2EnemyChance + tier1EnemyChance) {
-				activeEnemies.push_back(new EnemyCharacter(enemyContainer.at(3) + "/idle", enemyContainer.at(3) + "/run", tier3EnemyMvSpeed, tier3EnemyHP));
-				index += 3;
-			}
-			else {
-				activeEnemies.push_back(new EnemyCharacter(enemyContainer.at(4) + "/idle", enemyContainer.at(4) + "/run", tier3EnemyMvSpeed, tier3EnemyHP));
-				index += 3;
-			}
+			unsigned int tier = 4;
+			if (enemyTier < tier1EnemyChance) tier = 1;
+			else if (enemyTier < tier2EnemyChance + tier1EnemyChance) tier = 2;
+			else if (enemyTier < tier3EnemyChance + tier2EnemyChance + tier1EnemyChance) tier = 3;
 
-			unsigned int x = getRandomInRange(room->getX() + 1.f, room->getX() + room->getWidth() - 1.f) * tileSize.x;
-			unsigned int y = getRandomInRange(room->getY() + 1.f, room->getY() + room->getHeight() - 1.f) * tileSize.y;
+			const float speeds[] = { tier1EnemyMvSpeed, tier2EnemyMvSpeed, tier3EnemyMvSpeed, tier3EnemyMvSpeed };
+			const int hitPoints[] = { tier1EnemyHP, tier2EnemyHP, tier3EnemyHP, tier3EnemyHP };
+			index += std::min(tier, 3u);
 
-			activeEnemies.back()->setPosition(sf::Vector2f(x, y));
+			unsigned int x = spawnRandom.getInRange(spawnStream, room.x + 1, room.x + room.width - 1) * tileSize.x;
+			unsigned int y = spawnRandom.getInRange(spawnStream, room.y + 1, room.y + room.height - 1) * tileSize.y;
+
+			loadClips(tier);
+			const SlotHandle enemy = enemies.add(idleClips[tier], runClips[tier], speeds[tier - 1], hitPoints[tier - 1], random, sf::Vector2f(x, y) + offset);
+			if (renderQueue != nullptr) renderQueue->add(enemies.getRenderNode(enemies.find(enemy)));
 		}
 	}
 
+public:
+
+	EnemyController(RandomGenerator* rG, AnimationSystem* aS) : enemies(aS), random(rG), animations(aS), renderQueue(nullptr)
+	{
+		std::fill(std::begin(idleClips), std::end(idleClips), nullptr);
+		std::fill(std::begin(runClips), std::end(runClips), nullptr);
+	}
+
+	~EnemyController()
+	{
+		reset();
+	}
+
+	// Hits every enemy inside the weapon's bounds, killed ones may drop a potion
 	void applyDamage(unsigned int weapon_damage, const sf::FloatRect& weapon_bounds, ItemContainer* potionContainer) 
 	{
-		auto it = activeEnemies.begin();
+		hits.clear();
+		enemies.forEachTouching(weapon_bounds, [&](std::size_t i) { hits.push_back(i); });
+
+		// Removing an enemy moves the last one into its place, so going from the back leaves the
+		// positions of the hits still to come as they were
+		std::sort(hits.begin(), hits.end(), std::greater<std::size_t>());
 
-		while (it != activeEnemies.end()) 
+		for (std::size_t i : hits)
 		{
-			if ((*it)->getGlobalBounds().intersects(weapon_bounds)) 
-			{
-				(*it)->takeDamage(weapon_damage);
-
-				if ((*it)->getCurrentHP() <= 0) 
-				{
-					EnemyCharacter* ptr = (*it);
-
-					int dropPotion = getRandomInRange(0, 100);
-					if (dropPotion <= healPotionChance) 
-					{
-						HealingPotion* potion = new HealingPotion;
-						potion->setPosition(ptr->getPosition());
-						potionContainer->addItem(potion);
-					}
-					else if (dropPotion <= speedPotionChance) {
-						SpeedPotion* potion = new SpeedPotion;
-						potion->setPosition(ptr->getPosition());
-						potionContainer->addItem(potion);
-					}
-					else if (dropPotion <= invincibilityPotionChance) {
-						InvincibilityPotion* potion = new InvincibilityPotion;
-						potion->setPosition(ptr->getPosition());
-						potionContainer->addItem(potion);
-					}
-
-					delete ptr;
-					it = activeEnemies.erase(it);
-				}
-				else {
-					++it;
-				}
-			}
-			else {
-				++it;
-			}
-		}
+			enemies.takeDamage(i, weapon_damage);
 
-		if (boss->getGlobalBounds().intersects(weapon_bounds)) {
-			boss->takeDamage(weapon_damage);
-		}
-	}
+			// The boss stays until the level ends
+			if (enemies.getHandle(i) == boss || enemies.getCurrentHP(i) > 0) continue;
 
-public:
+			const sf::Vector2f position = enemies.getPosition(i);
 
-	~EnemyController()
-	{
-		reset();
+			int dropPotion = random->getInRange(lootStream, 0, 100);
+			if (dropPotion <= healPotionChance) potionContainer->spawnItem(healingPotion, position);
+			else if (dropPotion <= speedPotionChance) potionContainer->spawnItem(speedPotion, position);
+			else if (dropPotion <= invincibilityPotionChance) potionContainer->spawnItem(invincibilityPotion, position);
+
+			enemies.remove(i);
+		}
 	}
 
 	void reset() 
 	{
-		for (EnemyCharacter* enemy : activeEnemies) {
-			delete enemy;
-		}
-		delete boss;
-		activeEnemies.clear();
-		enemyContainer.clear();
+		enemies.clear();
+		boss = SlotHandle();
+		enemySet = EnemySet();
+		std::fill(std::begin(idleClips), std::end(idleClips), nullptr);
+		std::fill(std::begin(runClips), std::end(runClips), nullptr);
 	}
 
-	void loadEnemies(const std::string& directoryPath)
+	void setRenderQueue(RenderQueue* queue) { renderQueue = queue; }
+
+	// The dungeon's enemy directories, listed at startup
+	void loadEnemies(const EnemySet& directories)
 	{
 		reset();
+		enemySet = directories;
+	}
 
-		for (const auto & entry : fs::directory_iterator(directoryPath)) 
+	void spawnEnemies(const LevelLayout& level, unsigned int bossHP, float bossMvSpeed)
+	{
+		for (int32_t i = 0; i < int32_t(level.roomCount); i++) 
 		{
-			if (fs::is_directory(entry.path())) 
-			{
-				std::string directoryName = entry.path().filename().string();
-
-				if (directoryName == "boss") {
-					for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
-					{
-						if (fs::is_directory(entry.path()))
-						{
-							bossAnimPath = directoryPath + directoryName + "/" + entry.path().filename().string();
-						}
-					}
-				}
-				else {
-					unsigned int enemyTier = convertDirectoryNameToInt(directoryName);
-					for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
-					{
-						if (fs::is_directory(entry.path()))
-						{
-							std::string enemyAnimPath = directoryPath + directoryName + "/" + entry.path().filename().string();
-							enemyContainer.insert(std::make_pair(enemyTier, enemyAnimPath));
-						}
-					}
-				}
+			const LevelRect& room = level.rooms[i];
+
+			if (i == level.bossRoom) {
+				unsigned int x = random->getInRange(spawnStream, room.x + 1, room.x + room.width - 1) * tileSize.x;
+				unsigned int y = random->getInRange(spawnStream, room.y + 1, room.y + room.height - 1) * tileSize.y;
+
+				loadClips(0);
+				boss = enemies.add(idleClips[0], runClips[0], bossMvSpeed, bossHP, random, sf::Vector2f(x, y), 30.f, 35.f);
+				if (renderQueue != nullptr) renderQueue->add(enemies.getRenderNode(enemies.find(boss)));
+			}
+			else if (i != level.spawnRoom) {
+				unsigned int capacity = (room.width * room.height) / tilesPerOneCapacityPoint;
+				createEnemies(capacity, room, sf::Vector2f(0.f, 0.f), *random);
 			}
 		}
 	}
 
-	void spawnEnemies(const std::vector<Room*> rooms, const Room* bossRoom, const Room* spawnRoom, unsigned int bossHP, float bossMvSpeed)
+	// Endless mode sectors have no boss; spawns come from the sector's own generator so they don't depend on load order
+	void spawnSectorEnemies(const LevelLayout& level, const sf::Vector2f& offset, RandomGenerator& sectorRandom)
 	{
-		for (const Room* room : rooms) 
+		for (int32_t i = 0; i < int32_t(level.roomCount); i++)
 		{
-			if (room == bossRoom) {
-				boss = new EnemyCharacter(bossAnimPath + "/idle", bossAnimPath + "/run", bossMvSpeed, bossHP, 30.f, 35.f);
-				unsigned int x = getRandomInRange(room->getX() + 1.f, room->getX() + room->getWidth() - 1.f) * tileSize.x;
-				unsigned int y = getRandomInRange(room->getY() + 1.f, room->getY() + room->getHeight() - 1.f) * tileSize.y;
+			if (i == level.spawnRoom) continue;
 
-				boss->setPosition(sf::Vector2f(x, y));
-			}
-			else if (room != spawnRoom) {
-				unsigned int capacity = (room->getWidth() * room->getHeight()) / tilesPerOneCapacityPoint;
-				createEnemies(capacity, room);
-			}
+			const LevelRect& room = level.rooms[i];
+			unsigned int capacity = (room.width * room.height) / tilesPerOneCapacityPoint;
+			createEnemies(capacity, room, offset, sectorRandom);
 		}
 	}
 
-	void update(const float& dt, PlayerCharacter* player, CollisionController* cc, ItemContainer* potionContainer)
+	// Drops enemies that ended up outside the area, e.g. in an evicted sector
+	void removeOutside(const sf::FloatRect& area)
 	{
-		for (EnemyCharacter* enemy : activeEnemies) {
-			enemy->update(dt, player);
-			cc->update(enemy);
-		}
-		boss->update(dt, player);
-		cc->update(boss);
-		if (player->canAttack(dt)) {
-			applyDamage(player->getWeaponDamage(), player->getWeaponHitbox(), potionContainer);
+		std::size_t i = 0;
+
+		while (i < enemies.size())
+		{
+			if (!area.contains(enemies.getPosition(i))) enemies.remove(i);
+			else ++i;
 		}
 	}
 
-	std::vector<sf::Sprite> getEnemySprites() {
-		std::vector<sf::Sprite> v;
-		for (EnemyCharacter* enemy : activeEnemies) {
-			v.push_back(enemy->getSprite());
+	void translate(const sf::Vector2f& offset) { enemies.translate(offset); }
+
+	void update(const float& dt, PlayerCharacter* player, CollisionController* cc, ItemContainer* potionContainer)
+	{
+		enemies.think(dt, player->getPosition());
+		enemies.integrate(dt);
+		enemies.collide(cc);
+		enemies.separate();
+		enemies.touch(player);
+		enemies.show();
+
+		if (player->canAttack(dt)) {
+			applyDamage(player->getWeaponDamage(), player->getWeaponHitbox(), potionContainer);
 		}
-		v.push_back(boss->getSprite());
-		return v;
 	}
 
-	std::vector<sf::RectangleShape> getEnemyHealthbars() 
+	bool bossDefeated()
 	{
-		std::vector<sf::RectangleShape> v;
-		for (EnemyCharacter* enemy : activeEnemies) {
-			if (enemy->getCurrentHP() < enemy->getMaxHP()) {
-				v.push_back(enemy->getHealthbar());
-			}
-		}
-		if (boss->getCurrentHP() < boss->getMaxHP()) {
-			v.push_back(boss->getHealthbar());
-		}
-		return v;
+		const std::size_t position = enemies.find(boss);
+		return position != SlotIndex::npos && enemies.getCurrentHP(position) <= 0;
 	}
 
-	bool bossDefeated() { return boss->getCurrentHP() <= 0; }
+	std::size_t getEnemyCount() const { return enemies.size(); }
 };
\ No newline at end of file
@@ -0,0 +1,359 @@
+#pragma once
+
+// Every enemy of a level as parallel arrays, one per component, all indexed alike. Each pass of a frame
+// walks only the arrays it needs, front to back, so a few thousand enemies cost a few cache misses more
+// than a hundred. Sprites and health bars are cold, they are written once at the end of the frame to show
+// the result. They sit in deques because the render queue and the animation system point at them, and a
+// deque never moves what it holds. Removing an enemy moves the last one into its place, and the slot
+// left at the end of the deques is kept for the next enemy, so spawning and killing allocate nothing
+// once the store has grown to its largest crowd. Passes that look at enemies near a point, such as
+// contact with the player, weapon hits and enemies keeping apart, find them in a spatial hash of their
+// positions, rebuilt on the first such look after enemies moved
+class EnemyStore {
+private:
+
+	// Finds an enemy by handle, wherever removals moved it
+	SlotIndex handles;
+
+	// Hot, touched by every pass
+	std::vector<sf::Vector2f> positions;
+	std::vector<sf::Vector2f> velocities;
+	std::vector<sf::Vector2f> separations;
+	std::vector<sf::Vector2f> sizes;
+	std::vector<float> speeds;
+	std::vector<int> hitPoints;
+	std::vector<int> maxHitPoints;
+
+	// An enemy chases the player for its move time, then rests for its idle time, and starts over
+	std::vector<float> aiTimes;
+	std::vector<float> moveTimes;
+	std::vector<float> idleTimes;
+
+	// Playback slots in the animation system, and the clips they switch between
+	std::vector<unsigned int> animationIds;
+	std::vector<const AnimationClip*> idleClips;
+	std::vector<const AnimationClip*> runClips;
+
+	// Cold, only written by show(). Longer than the hot arrays when enemies were removed
+	std::deque<sf::Sprite> sprites;
+	std::deque<sf::RectangleShape> healthbars;
+	std::deque<RenderNode> renderNodes;
+	std::vector<float> healthbarSizes;
+	std::vector<float> healthbarYOffsets;
+
+	// Positions sorted into cells, valid until enemies move, come or go
+	SpatialHash grid;
+	bool gridCurrent;
+
+	// Largest sprite ever added since the last clear(), how far bounds reach from their positions
+	sf::Vector2f largestSize;
+
+	AnimationSystem* animations;
+
+	template <typename Container>
+	static void moveLast(Container& container, std::size_t position)
+	{
+		container[position] = container.back();
+		container.pop_back();
+	}
+
+public:
+
+	EnemyStore(AnimationSystem* _animations) : grid(enemyGridCellSize * tileSize.x), gridCurrent(false), largestSize(0.f, 0.f), animations(_animations) {}
+
+	EnemyStore(const EnemyStore&) = delete;
+	EnemyStore& operator=(const EnemyStore&) = delete;
+
+	~EnemyStore()
+	{
+		clear();
+	}
+
+	SlotHandle add(const AnimationClip* idleClip, const AnimationClip* runClip, float speed, int hp, RandomGenerator* random, const sf::Vector2f& position, float healthbarSize = 12.f, float healthbarYOffset = 18.f);
+
+	void remove(std::size_t position);
+
+	void clear();
+
+	std::size_t size() const { return positions.size(); }
+
+	// Position of the enemy in the arrays, SlotIndex::npos once it was removed
+	std::size_t find(const SlotHandle& handle) const { return handles.find(handle); }
+
+	SlotHandle getHandle(std::size_t position) const { return handles.getHandle(position); }
+
+	// Passes of one frame, in this order
+
+	// Picks each enemy's velocity: towards the player while moving and close enough, none otherwise
+	void think(float deltaTime, const sf::Vector2f& playerPosition);
+
+	// Moves each enemy by its velocity and by the separation the last frame's separate() found for it
+	void integrate(float deltaTime)
+	{
+		for (std::size_t i = 0; i < positions.size(); i++) positions[i] += (velocities[i] + separations[i]) * deltaTime;
+		gridCurrent = false;
+	}
+
+	// Pushes enemies that walked off the floor back onto it
+	void collide(CollisionController* collisionController)
+	{
+		for (std::size_t i = 0; i < positions.size(); i++) positions[i] = collisionController->resolve(positions[i], getBounds(i));
+		gridCurrent = false;
+	}
+
+	// Picks the velocity that moves overlapping enemies apart over the next frames, so a crowd chasing the
+	// player spreads out instead of stacking into one sprite
+	void separate();
+
+	// Every enemy touching the player hurts it
+	void touch(PlayerCharacter* player)
+	{
+		forEachTouching(player->getHitbox(), [&](std::size_t) { player->takeDamage(enemyContactDamage); });
+	}
+
+	// Copies the frame's result to the sprites, animations and health bars
+	void show();
+
+	void translate(const sf::Vector2f& offset);
+
+	void takeDamage(std::size_t position, unsigned int damage) { hitPoints[position] -= damage; }
+
+	int getCurrentHP(std::size_t position) const { return hitPoints[position]; }
+
+	const sf::Vector2f& getPosition(std::size_t position) const { return positions[position]; }
+
+	// Same box as the sprite's global bounds, the origin is at the bottom centre and flipping keeps it there
+	sf::FloatRect getBounds(std::size_t position) const
+	{
+		const sf::Vector2f& size = sizes[position];
+		return sf::FloatRect(positions[position].x - size.x * 0.5f, positions[position].y - size.y, size.x, size.y);
+	}
+
+	RenderNode& getRenderNode(std::size_t position) { return renderNodes[position]; }
+
+	// Calls visit with the position of every enemy whose bounds intersect the area. Only looks at the
+	// enemies in the grid cells around the area, however many the level has
+	template <typename Visit>
+	void forEachTouching(const sf::FloatRect& area, Visit visit)
+	{
+		index();
+
+		const sf::FloatRect reach(area.left - largestSize.x * 0.5f, area.top, area.width + largestSize.x, area.height + largestSize.y);
+		grid.query(reach, [&](uint32_t i, const sf::Vector2f&) {
+			if (area.intersects(getBounds(i))) visit(std::size_t(i));
+		});
+	}
+
+	// Sorts the positions into the grid, if they changed since the last time
+	void index()
+	{
+		if (gridCurrent) return;
+
+		grid.build(positions);
+		gridCurrent = true;
+	}
+};
+
+SlotHandle EnemyStore::add(const AnimationClip* idleClip, const AnimationClip* runClip, float speed, int hp, RandomGenerator* random, const sf::Vector2f& position, float healthbarSize, float healthbarYOffset)
+{
+	const std::size_t slot = positions.size();
+	if (slot == sprites.size()) {
+		sprites.emplace_back();
+		healthbars.emplace_back();
+		healthbars.back().setFillColor(sf::Color::Red);
+		renderNodes.emplace_back(&sprites.back());
+		renderNodes.back().setOverlay(&healthbars.back());
+	}
+	else sprites[slot] = sf::Sprite();
+
+	sf::Sprite& sprite = sprites[slot];
+
+	// Start with idle animation
+	const unsigned int animation = animations->create(idleClip, &sprite);
+	animations->play(animation);
+
+	// Set sprite's origin to it's center on x axis
+	const sf::IntRect& frame = animations->getCurrentFrame(animation).rect;
+	const sf::Vector2f spriteSize(frame.width, frame.height);
+	sprite.setOrigin(sf::Vector2f(spriteSize.x * 0.5f, spriteSize.y));
+	sprite.setPosition(position);
+
+	healthbars[slot].setSize(sf::Vector2f(healthbarSize, 1));
+	renderNodes[slot].showOverlay(true);
+
+	positions.push_back(position);
+	velocities.push_back(sf::Vector2f(0.f, 0.f));
+	separations.push_back(sf::Vector2f(0.f, 0.f));
+	sizes.push_back(spriteSize);
+	largestSize.x = std::max(largestSize.x, spriteSize.x);
+	largestSize.y = std::max(largestSize.y, spriteSize.y);
+	speeds.push_back(speed);
+	hitPoints.push_back(hp);
+	maxHitPoints.push_back(hp);
+
+	aiTimes.push_back(0.f);
+	moveTimes.push_back(float(random->getInRange(aiStream, 5, 20)));
+	idleTimes.push_back(float(random->getInRange(aiStream, 0, 5)));
+
+	animationIds.push_back(animation);
+	idleClips.push_back(idleClip);
+	runClips.push_back(runClip);
+
+	healthbarSizes.push_back(healthbarSize);
+	healthbarYOffsets.push_back(healthbarYOffset);
+
+	gridCurrent = false;
+	return handles.add();
+}
+
+void EnemyStore::remove(std::size_t position)
+{
+	animations->destroy(animationIds[position]);
+
+	const bool moved = position + 1 != positions.size();
+	handles.remove(position);
+
+	moveLast(positions, position);
+	moveLast(velocities, position);
+	moveLast(separations, position);
+	moveLast(sizes, position);
+	moveLast(speeds, position);
+	moveLast(hitPoints, position);
+	moveLast(maxHitPoints, position);
+	moveLast(aiTimes, position);
+	moveLast(moveTimes, position);
+	moveLast(idleTimes, position);
+	moveLast(animationIds, position);
+	moveLast(idleClips, position);
+	moveLast(runClips, position);
+	moveLast(healthbarSizes, position);
+	moveLast(healthbarYOffsets, position);
+
+	// The node of the hole keeps its place in the render queue and now shows the moved enemy,
+	// the slot at the end leaves the queue and waits for the next add()
+	const std::size_t last = positions.size();
+	if (moved) {
+		sprites[position] = sprites[last];
+		healthbars[position] = healthbars[last];
+		animations->setSprite(animationIds[position], &sprites[position]);
+	}
+	renderNodes[last].leaveQueue();
+
+	gridCurrent = false;
+}
+
+void EnemyStore::clear()
+{
+	for (unsigned int animation : animationIds) animations->destroy(animation);
+	for (RenderNode& node : renderNodes) node.leaveQueue();
+	handles.clear();
+
+	positions.clear();
+	velocities.clear();
+	separations.clear();
+	sizes.clear();
+	speeds.clear();
+	hitPoints.clear();
+	maxHitPoints.clear();
+	aiTimes.clear();
+	moveTimes.clear();
+	idleTimes.clear();
+	animationIds.clear();
+	idleClips.clear();
+	runClips.clear();
+	healthbarSizes.clear();
+	healthbarYOffsets.clear();
+
+	largestSize = sf::Vector2f(0.f, 0.f);
+	gridCurrent = false;
+}
+
+void EnemyStore::think(float deltaTime, const sf::Vector2f& playerPosition)
+{
+	const float detectRange = enemyDetectRange * tileSize.x;
+
+	for (std::size_t i = 0; i < positions.size(); i++)
+	{
+		velocities[i] = sf::Vector2f(0.f, 0.f);
+
+		aiTimes[i] += deltaTime;
+		if (aiTimes[i] > moveTimes[i]) {
+			if (aiTimes[i] < moveTimes[i] + idleTimes[i]) continue;
+			aiTimes[i] = 0.f;
+		}
+
+		const sf::Vector2f direction = playerPosition - positions[i];
+		const float distance = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+		if (distance > detectRange || distance == 0.f) continue;
+
+		// Speed is applied twice, as Character::move does for the player
+		velocities[i] = direction * (speeds[i] * speeds[i] / distance);
+	}
+}
+
+void EnemyStore::separate()
+{
+	index();
+
+	// Neighbours in turn share most of their neighbourhood
+	grid.forEach([&](uint32_t i, const sf::Vector2f& position) {
+		const sf::FloatRect neighbourhood(position.x - largestSize.x, position.y - largestSize.x, largestSize.x * 2, largestSize.x * 2);
+
+		// Two enemies closer than the mean of their widths push each other, harder the more they overlap
+		sf::Vector2f push(0.f, 0.f);
+		grid.query(neighbourhood, [&](uint32_t j, const sf::Vector2f& neighbour) {
+			if (j == i) return;
+
+			const sf::Vector2f away = position - neighbour;
+			const float spacing = (sizes[i].x + sizes[j].x) * 0.5f;
+			const float distanceSquared = away.x * away.x + away.y * away.y;
+			if (distanceSquared >= spacing * spacing) return;
+
+			// Enemies on the same spot part in a direction picked by the pair, so a stack of them fans out
+			if (distanceSquared == 0.f) {
+				const float angle = float(std::min(i, j) * 7 + std::max(i, j) * 13);
+				const float side = i < j ? -1.f : 1.f;
+				push += sf::Vector2f(std::cos(angle), std::sin(angle)) * side;
+				return;
+			}
+
+			const float distance = std::sqrt(distanceSquared);
+			push += away * ((spacing - distance) / (spacing * distance));
+		});
+
+		const float length = std::sqrt(push.x * push.x + push.y * push.y);
+		if (length > 1.f) push /= length;
+		separations[i] = push * enemySeparationSpeed;
+	});
+}
+
+void EnemyStore::show()
+{
+	for (std::size_t i = 0; i < positions.size(); i++)
+	{
+		sf::Sprite& sprite = sprites[i];
+		sprite.setPosition(positions[i]);
+
+		const sf::Vector2f& velocity = velocities[i];
+		if (velocity.x > 0) sprite.setScale(1.f, 1.f);
+		else if (velocity.x < 0) sprite.setScale(-1.f, 1.f);
+
+		const bool running = velocity.x != 0.f || velocity.y != 0.f;
+		animations->play(animationIds[i], running ? runClips[i] : idleClips[i]);
+
+		const float healthPercentage = (float)hitPoints[i] / (float)maxHitPoints[i];
+		healthbars[i].setSize(sf::Vector2f(healthbarSizes[i] * healthPercentage, 1));
+		healthbars[i].setPosition(sf::Vector2f(positions[i].x - healthbarSizes[i] / 2, positions[i].y - healthbarYOffsets[i]));
+	}
+}
+
+void EnemyStore::translate(const sf::Vector2f& offset)
+{
+	for (std::size_t i = 0; i < positions.size(); i++) {
+		positions[i] += offset;
+		sprites[i].move(offset);
+		healthbars[i].move(offset);
+	}
+
+	gridCurrent = false;
+}
\ No newline at end of file
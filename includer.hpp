@@ -7,8 +7,32 @@
 #include <vector>
 #include <map>
 #include <random>
+#include <cstdint>
+#include <limits>
 #include <chrono>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
+#include <fstream>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <iostream>
 
 namespace fs = std::filesystem;
@@ -22,6 +46,15 @@ static const float cameraSizeY = 300.f;
 
 static const sf::Vector2u tileSize(16, 16);
 
+// Map renderers group tiles into square chunks of this many tiles and draw only the chunks in view
+static const unsigned int renderChunkSize = 16;
+
+// Character, weapon, item and chest images are packed into atlas pages of at most this many pixels a side
+static const unsigned int atlasPageSize = 1024;
+
+// More entities than this joining the render queue in one frame are sorted in from scratch rather than one by one
+static const unsigned int renderQueueResortCount = 32;
+
 // Dungeon parameters
 
 static const unsigned int minRoomSize = 14;
@@ -29,6 +62,9 @@ static const unsigned int maxRoomSize = 16;
 static const unsigned int roomMargin = 2;
 static const unsigned int corridorWidth = 2;
 
+// Empty tiles around the dungeon on every side, filled by the background
+static const unsigned int dungeonMargin = 20;
+
 static const unsigned int dungeon1width = 40;
 static const unsigned int dungeon1height = 60;
 
@@ -38,6 +74,21 @@ static const unsigned int dungeon2height = 80;
 static const unsigned int dungeon3width = 80;
 static const unsigned int dungeon3height = 100;
 
+// Partitions with at least this many tiles split their children on the worker pool, when one is given
+static const unsigned int parallelSplitMinArea = 256 * 256;
+
+// Endless mode: the world is a grid of square sectors, each one a small BSP dungeon
+
+static const unsigned int sectorSize = 48;
+static const unsigned int sectorPadding = 3;
+
+// Sectors are generated up to the load radius around the player's sector and evicted past the evict radius
+static const unsigned int sectorLoadRadius = 1;
+static const unsigned int sectorEvictRadius = 2;
+
+// Coordinates are shifted once the player gets this many sectors away from the origin, keeping floats precise
+static const unsigned int sectorRebaseDistance = 4;
+
 // Potions
 
 static const std::string healPotionTexture = "./assets/potions/heal_potion.png";
@@ -53,6 +104,11 @@ static const unsigned int invincibilityPotionChance = 15;
 
 static const unsigned int tilesPerOneCapacityPoint = 24;
 
+static const unsigned int enemyContactDamage = 1;
+static const float enemyDetectRange = 7.f; // tiles
+static const float enemySeparationSpeed = 60.f; // pixels per second, at full overlap
+static const float enemyGridCellSize = 2.f; // tiles
+
 static const unsigned int tier1EnemyChance = 30;
 static const unsigned int tier2EnemyChance = 30;
 static const unsigned int tier3EnemyChance = 20;
@@ -101,8 +157,26 @@ static const std::string dungeon3EnemiesDir = "./assets/dungeon3/enemies/";
 
 static const std::string healthbarTexture = "./assets/healthbar/healthbar.png";
 
+// HUD numerals are rasterised from the font once and packed into the sprite atlas as digit0.png ... digit9.png
+static const std::string hudFont = "./assets/fonts/font.ttf";
+static const std::string hudDigits = "./assets/fonts/digit";
+static const unsigned int hudDigitSize = 48;
+static const float hudDigitScale = .2f;
+
 static const std::string weaponsDir = "./assets/weapons/";
 
+static const std::string heroesDir = "./assets/heroes/";
+static const std::string potionsDir = "./assets/potions/";
+static const std::string chestDir = "./assets/chest/";
+
+// Written by asset_packer from the files under assetSourceDir; when present the game maps it instead of
+// reading the files above
+static const std::string assetSourceDir = "./assets/";
+static const std::string assetBundlePath = "./assets/assets.bundle";
+
+// Levels saved here as level<N>.lvl are loaded instead of generated
+static const std::string pinnedLevelsDir = "./levels/";
+
 static const std::string chestOpenAnim = "./assets/chest/chest_empty_open_anim_f";
 
 static const std::string elfIdleAnim = "./assets/heroes/elf/elf_m_idle_anim_f";
@@ -117,28 +191,36 @@ static const std::string lizardRunAnim = "./assets/heroes/lizard/lizard_m_run_an
 static const std::string wizardIdleAnim = "./assets/heroes/wizzard/wizzard_m_idle_anim_f";
 static const std::string wizardRunAnim = "./assets/heroes/wizzard/wizzard_m_run_anim_f";
 
-// Functions
-
-int getRandomInRange(int min, int max) 
-{
-	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine generator(seed);
-
-	std::uniform_int_distribution<int> distribution(min, max);
-
-	return distribution(generator);
-}
-
 // Header files
 
+#include "allocation_counter.hpp"
+#include "random_generator.hpp"
+#include "thread_pool.hpp"
+#include "phase_timer.hpp"
+#include "slot_map.hpp"
+#include "level_file.hpp"
 #include "dungeon_generator.hpp"
+
+// Tools that only generate layouts define DUNGEON_HEADLESS and need no window, textures or SFML libraries
+
+#ifndef DUNGEON_HEADLESS
+#include "texture_cache.hpp"
 #include "map_renderer.hpp"
+#include "sprite_atlas.hpp"
+#include "asset_bundle.hpp"
+#include "render_queue.hpp"
 #include "animation.hpp"
 #include "weapon.hpp"
 #include "items.hpp"
 #include "character.hpp"
 #include "chest.hpp"
 #include "collision_controller.hpp"
+#include "spatial_hash.hpp"
+#include "enemy_store.hpp"
 #include "enemy_controller.hpp"
+#include "endless_dungeon.hpp"
+#include "level_loader.hpp"
 #include "interface_elements.hpp"
-#include "utilities.hpp"
\ No newline at end of file
+#include "utilities.hpp"
+#include "map_benchmark.hpp"
+#endif
\ No newline at end of file
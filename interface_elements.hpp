@@ -1,5 +1,48 @@
 #pragma once
 
+// A progress bar in the middle of the view, redrawn while the assets are decoded on the worker threads
+class LoadingScreen {
+private:
+
+	sf::RenderWindow& window;
+	sf::RectangleShape frame;
+	sf::RectangleShape bar;
+
+public:
+
+	LoadingScreen(sf::RenderWindow& window) : window(window)
+	{
+		frame.setFillColor(sf::Color::Transparent);
+		frame.setOutlineColor(sf::Color::White);
+		frame.setOutlineThickness(1.f);
+
+		bar.setFillColor(sf::Color::White);
+	}
+
+	void render(const sf::View& viewport, std::size_t done, std::size_t total)
+	{
+		// Nothing else polls the window until the game loop starts
+		sf::Event event;
+		while (window.pollEvent(event)) {
+			if (event.type == sf::Event::Closed) window.close();
+		}
+
+		const sf::Vector2f size(viewport.getSize().x / 2.f, 4.f);
+		const sf::Vector2f position = viewport.getCenter() - size / 2.f;
+		const float progress = total == 0 ? 1.f : float(done) / float(total);
+
+		frame.setSize(size);
+		frame.setPosition(position);
+		bar.setSize(sf::Vector2f(size.x * progress, size.y));
+		bar.setPosition(position);
+
+		window.clear();
+		window.draw(frame);
+		window.draw(bar);
+		window.display();
+	}
+};
+
 class EndGameScreen {
 private:
 
@@ -52,70 +95,124 @@ public:
 	}
 };
 
-class PotionStatus {
+// Hearts, potion icons and potion counts, all from the sprite atlas and drawn as one batch.
+// The geometry is laid out relative to the top left corner of the view and rebuilt only when the hit points,
+// a potion count or the size of the view change; following the camera only moves the transform
+class PlayerHud : public sf::Drawable, public sf::Transformable {
 private:
 
-	sf::RenderWindow& window;
+	const TextureAtlas* atlas;
+	SpriteBatch batch;
 
-	sf::Font font;
-	sf::Text healPotions;
-	sf::Text speedPotions;
-	sf::Text invinPotions;
+	AtlasRegion hearts;
+	AtlasRegion potionIcons[3];
+	std::vector<AtlasRegion> digits;
 
-	HealingPotion healTexture;
-	SpeedPotion speedTexture;
-	InvincibilityPotion invinTexture;
+	// What the batch was last built for
+	bool built;
+	int shownHitPoints;
+	int shownMaxHitPoints;
+	unsigned int shownPotions[3];
+	sf::Vector2f shownViewSize;
 
-public:
+	unsigned int rebuilds;
 
-	PotionStatus(sf::RenderWindow& window) : window(window)
+	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
 	{
-		if (!font.loadFromFile("./assets/fonts/font.ttf")) {
-			// Handle font loading error
+		states.transform *= getTransform();
+		target.draw(batch, states);
+	}
+
+	void addRegion(const AtlasRegion& region, const sf::IntRect& rect, const sf::Vector2f& position, float scale = 1.f)
+	{
+		sf::Sprite sprite;
+		atlas->apply(sprite, region);
+		sprite.setTextureRect(rect);
+		sprite.setPosition(position);
+		sprite.setScale(scale, scale);
+		batch.add(sprite);
+	}
+
+	// The heart image holds a full, a half and an empty heart side by side
+	void addHearts(int hitPoints, int maxHitPoints)
+	{
+		const int fullHearts = std::max(hitPoints, 0) / 2;
+		const int halfHeart = std::max(hitPoints, 0) % 2;
+
+		for (int i = 0; i < maxHitPoints / 2; i++)
+		{
+			const int state = i < fullHearts ? 0 : i < fullHearts + halfHeart ? 1 : 2;
+			const sf::IntRect rect(hearts.rect.left + state * tileSize.x, hearts.rect.top, tileSize.x, tileSize.y);
+
+			addRegion(hearts, rect, sf::Vector2f(10.f + i * tileSize.x, 10.f));
 		}
+	}
+
+	void addNumber(unsigned int number, const sf::Vector2f& center)
+	{
+		if (digits.size() != 10) return;
 
-		healPotions.setFont(font);
-		healPotions.setCharacterSize(48);
-		healPotions.setScale(.2f, .2f);
+		const std::string text = std::to_string(number);
 
-		invinPotions.setFont(font);
-		invinPotions.setCharacterSize(48);
-		invinPotions.setScale(.2f, .2f);
+		float width = 0.f;
+		for (char digit : text) width += digits[digit - '0'].rect.width * hudDigitScale;
 
-		speedPotions.setFont(font);
-		speedPotions.setCharacterSize(48);
-		speedPotions.setScale(.2f, .2f);
+		sf::Vector2f position(center.x - width / 2.f, center.y - digits[0].rect.height * hudDigitScale / 2.f);
+		for (char digit : text)
+		{
+			const AtlasRegion& glyph = digits[digit - '0'];
+			addRegion(glyph, glyph.rect, position, hudDigitScale);
+			position.x += glyph.rect.width * hudDigitScale;
+		}
 	}
 
-	void render(sf::View& viewport, PlayerCharacter* player)
+	// Icons hang from their bottom centre like the potions lying on the floor
+	void addIcon(const AtlasRegion& icon, const sf::Vector2f& position)
 	{
-		healPotions.setString(std::to_string(player->getHealingPotions()));
-		speedPotions.setString(std::to_string(player->getSpeedPotions()));
-		invinPotions.setString(std::to_string(player->getInvinPotions()));
+		addRegion(icon, icon.rect, position - sf::Vector2f(icon.rect.width * 0.5f, float(icon.rect.height)));
+	}
 
-		sf::Vector2f viewportCenter = viewport.getCenter();
+public:
+
+	PlayerHud(const TextureAtlas* atlas) : atlas(atlas), batch(atlas), built(false), shownHitPoints(0), shownMaxHitPoints(0), shownPotions(), rebuilds(0)
+	{
+		hearts = atlas->getRegion(healthbarTexture);
+		potionIcons[0] = atlas->getRegion(healPotionTexture);
+		potionIcons[1] = atlas->getRegion(speedPotionTexture);
+		potionIcons[2] = atlas->getRegion(invincibilityPotionTexture);
+		digits = atlas->getAnimation(hudDigits);
+	}
 
-		sf::FloatRect textBounds = healPotions.getLocalBounds();
-		healPotions.setOrigin(textBounds.left + textBounds.width / 2.0f, textBounds.top + textBounds.height / 2.0f);
-		healPotions.setPosition(viewportCenter.x + viewport.getSize().x / 2 - 90.f, viewportCenter.y - viewport.getSize().y / 2 + 15.f);
-		healTexture.setPosition(sf::Vector2f(healPotions.getPosition().x + 10.f, healPotions.getPosition().y + 6.f));
+	void update(const sf::View& viewport, const PlayerCharacter* player)
+	{
+		setPosition(viewport.getCenter() - viewport.getSize() / 2.f);
 
-		textBounds = speedPotions.getLocalBounds();
-		speedPotions.setOrigin(textBounds.left + textBounds.width / 2.0f, textBounds.top + textBounds.height / 2.0f);
-		speedPotions.setPosition(viewportCenter.x + viewport.getSize().x / 2 - 60.f, viewportCenter.y - viewport.getSize().y / 2 + 15.f);
-		speedTexture.setPosition(sf::Vector2f(speedPotions.getPosition().x + 10.f, speedPotions.getPosition().y + 6.f));
+		const unsigned int potions[3] = { player->getHealingPotions(), player->getSpeedPotions(), player->getInvinPotions() };
 
-		textBounds = invinPotions.getLocalBounds();
-		invinPotions.setOrigin(textBounds.left + textBounds.width / 2.0f, textBounds.top + textBounds.height / 2.0f);
-		invinPotions.setPosition(viewportCenter.x + viewport.getSize().x / 2 - 30.f, viewportCenter.y - viewport.getSize().y / 2 + 15.f);
-		invinTexture.setPosition(sf::Vector2f(invinPotions.getPosition().x + 10.f, invinPotions.getPosition().y + 6.f));
+		if (built && shownHitPoints == player->getCurrentHP() && shownMaxHitPoints == player->getMaxHP() && shownViewSize == viewport.getSize()
+			&& std::equal(potions, potions + 3, shownPotions)) return;
 
-		window.draw(healPotions);
-		window.draw(speedPotions);
-		window.draw(invinPotions);
+		shownHitPoints = player->getCurrentHP();
+		shownMaxHitPoints = player->getMaxHP();
+		std::copy(potions, potions + 3, shownPotions);
+		shownViewSize = viewport.getSize();
 
-		window.draw(healTexture.getSprite());
-		window.draw(speedTexture.getSprite());
-		window.draw(invinTexture.getSprite());
+		batch.clear();
+		addHearts(shownHitPoints, shownMaxHitPoints);
+
+		for (unsigned int i = 0; i < 3; i++) {
+			const sf::Vector2f center(shownViewSize.x - 90.f + i * 30.f, 15.f);
+			addNumber(potions[i], center);
+		}
+		for (unsigned int i = 0; i < 3; i++) {
+			const sf::Vector2f center(shownViewSize.x - 90.f + i * 30.f, 15.f);
+			addIcon(potionIcons[i], center + sf::Vector2f(10.f, 6.f));
+		}
+
+		built = true;
+		rebuilds++;
 	}
+
+	// How often the geometry was actually rebuilt, against the frames drawn
+	unsigned int getRebuildCount() const { return rebuilds; }
 };
\ No newline at end of file
@@ -2,82 +2,122 @@
 
 class PlayerCharacter;
 
+enum ItemKind { healingPotion, speedPotion, invincibilityPotion, itemKindCount };
+
 class Item {
 private:
 
+    ItemKind kind;
+
     sf::Sprite sprite;
-    sf::Texture texture;
+    RenderNode renderNode;
 
 public:
 
-    virtual ~Item() {}
-
-    Item(std::string texturePath)
+    Item(const TextureAtlas* atlas, ItemKind _kind) : kind(_kind), renderNode(&sprite)
     {
-        texture.loadFromFile(texturePath);
-        sprite.setTexture(texture);
+        const AtlasRegion& region = atlas->getRegion(getTexturePath(kind));
+        atlas->apply(sprite, region);
 
-        sf::Vector2f spriteSize(texture.getSize().x, texture.getSize().y);
+        sf::Vector2f spriteSize(region.rect.width, region.rect.height);
         sprite.setOrigin(sf::Vector2f(spriteSize.x * 0.5f, spriteSize.y));
     }
 
+    static const std::string& getTexturePath(ItemKind kind)
+    {
+        switch (kind) {
+        case speedPotion: return speedPotionTexture;
+        case invincibilityPotion: return invincibilityPotionTexture;
+        default: return healPotionTexture;
+        }
+    }
+
+    ItemKind getKind() const { return kind; }
+
     void setPosition(sf::Vector2f position) { sprite.setPosition(position); }
 
     sf::Sprite& getSprite() { return sprite; }
 
-    sf::FloatRect getBounds() { return sprite.getGlobalBounds(); }
-};
-
-class HealingPotion : public Item {
-public:
+    RenderNode& getRenderNode() { return renderNode; }
 
-    HealingPotion() : Item(healPotionTexture) {}
+    sf::FloatRect getBounds() { return sprite.getGlobalBounds(); }
 };
 
-class SpeedPotion : public Item {
-public:
+class ItemContainer {
+private:
 
-    SpeedPotion() : Item(speedPotionTexture) {}
-};
+    // Items on the ground, picking one up or dropping many costs O(1) each
+    SlotMap<Item*> items;
 
-class InvincibilityPotion : public Item {
-public:
+    // Picked up and removed items of each kind, handed out again by spawnItem() so drops allocate
+    // nothing once the pools have grown to what a level needs
+    std::vector<Item*> freeItems[itemKindCount];
 
-    InvincibilityPotion() : Item(invincibilityPotionTexture) {}
-};
+    const TextureAtlas* atlas;
+    RenderQueue* renderQueue;
 
-class ItemContainer {
-private:
-
-    std::vector<Item*> items;
+    void release(Item* item)
+    {
+        if (renderQueue != nullptr) renderQueue->remove(item->getRenderNode());
+        freeItems[item->getKind()].push_back(item);
+    }
 
 public:
 
+    ItemContainer(const TextureAtlas* tA, RenderQueue* queue = nullptr) : atlas(tA), renderQueue(queue) {}
+
     ~ItemContainer()
     {
         reset();
+
+        for (std::vector<Item*>& pool : freeItems) {
+            for (Item* item : pool) delete item;
+        }
     }
 
-    void reset() 
+    void reset()
     {
-        for (auto item : items) 
-        {
-            delete item;
-        }
+        for (Item* item : items) release(item);
         items.clear();
     }
 
     void update(PlayerCharacter* player);
 
-    void addItem(Item* item) { items.push_back(item); }
+    SlotHandle spawnItem(ItemKind kind, const sf::Vector2f& position)
+    {
+        Item* item = nullptr;
+        if (!freeItems[kind].empty()) {
+            item = freeItems[kind].back();
+            freeItems[kind].pop_back();
+        }
+        else item = new Item(atlas, kind);
+
+        item->setPosition(position);
+        if (renderQueue != nullptr) renderQueue->add(item->getRenderNode());
+        return items.insert(item);
+    }
 
-    std::vector<sf::Sprite> getSprites()
+    void translate(const sf::Vector2f& offset)
     {
-        std::vector<sf::Sprite> sprites;
-        for (auto item : items) 
+        for (auto item : items)
+        {
+            item->getSprite().move(offset);
+        }
+    }
+
+    void removeOutside(const sf::FloatRect& area)
+    {
+        std::size_t i = 0;
+
+        while (i < items.size())
         {
-            sprites.push_back(item->getSprite());
+            if (!area.contains(items[i]->getSprite().getPosition())) {
+                release(items[i]);
+                items.eraseAt(i);
+            }
+            else {
+                ++i;
+            }
         }
-        return sprites;
     }
 };
\ No newline at end of file
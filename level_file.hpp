@@ -0,0 +1,312 @@
+#pragma once
+
+// Rectangle in tile coordinates, the same layout in memory and on disk
+struct LevelRect {
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
+
+// Non-owning view of a finished level, backed either by a BSPDungeon or by a mapped level file.
+// Renderers, collision and spawning read it in place.
+struct LevelLayout {
+	uint64_t seed = 0;
+
+	const LevelRect* rooms = nullptr;
+	uint32_t roomCount = 0;
+
+	const LevelRect* corridors = nullptr;
+	uint32_t corridorCount = 0;
+
+	const uint32_t* chestRooms = nullptr;
+	uint32_t chestRoomCount = 0;
+
+	int32_t spawnRoom = -1;
+	int32_t bossRoom = -1;
+
+	// Row-major tile types and room ids, see TileGrid
+	const uint8_t* tiles = nullptr;
+	const int32_t* roomIds = nullptr;
+	int32_t gridWidth = 0;
+	int32_t gridHeight = 0;
+
+	bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < gridWidth && y < gridHeight; }
+
+	uint8_t getTile(int x, int y) const { return contains(x, y) ? tiles[size_t(y) * gridWidth + x] : 0; }
+
+	int getRoomId(int x, int y) const { return contains(x, y) ? roomIds[size_t(y) * gridWidth + x] : -1; }
+
+	sf::Vector2f getStartingPosition() const
+	{
+		const LevelRect& room = rooms[spawnRoom];
+		return sf::Vector2f((room.x + room.width / 2) * tileSize.x, (room.y + room.height / 2) * tileSize.y);
+	}
+};
+
+static const char levelFileMagic[4] = { 'L', 'V', 'L', 'F' };
+static const uint32_t levelFileVersion = 2;
+
+// Written as is, read back as 0x04030201 by a machine of the other byte order
+static const uint32_t levelFileByteOrder = 0x01020304;
+
+// Fixed-size header followed by the arrays it points at. Everything is in the byte order of the machine
+// that wrote it, which byteOrder records, and 8-byte aligned, so a mapped file can be used without
+// copying or parsing. A file from a machine of the other byte order is rejected rather than swapped.
+struct LevelFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t seed;
+	int32_t gridWidth;
+	int32_t gridHeight;
+	uint32_t roomCount;
+	uint32_t corridorCount;
+	uint32_t chestRoomCount;
+	int32_t spawnRoom;
+	int32_t bossRoom;
+	uint32_t byteOrder;
+	uint64_t roomsOffset;
+	uint64_t corridorsOffset;
+	uint64_t chestRoomsOffset;
+	uint64_t tilesOffset;
+	uint64_t roomIdsOffset;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+
+	const uint8_t* data;
+	size_t size;
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int descriptor;
+#endif
+
+public:
+
+#ifdef _WIN32
+	MappedFile() : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+#else
+	MappedFile() : data(nullptr), size(0), descriptor(-1) {}
+#endif
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() { close(); }
+
+	bool open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+		size = size_t(fileSize.QuadPart);
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			close();
+			return false;
+		}
+
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		descriptor = ::open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) return false;
+
+		struct stat status;
+		if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+			close();
+			return false;
+		}
+		size = size_t(status.st_size);
+
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+#endif
+
+		if (data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+		if (descriptor >= 0) ::close(descriptor);
+		descriptor = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	const uint8_t* getData() const { return data; }
+
+	size_t getSize() const { return size; }
+};
+
+class LevelFile {
+private:
+
+	MappedFile file;
+	LevelLayout layout;
+
+	// True if count elements of T at offset lie inside the file and are aligned
+	template <class T>
+	bool validArray(uint64_t offset, uint64_t count) const
+	{
+		return offset % alignof(T) == 0 && offset <= file.getSize() && count <= (file.getSize() - offset) / sizeof(T);
+	}
+
+	template <class T>
+	const T* getArray(uint64_t offset) const { return reinterpret_cast<const T*>(file.getData() + offset); }
+
+	// True if every rectangle lies inside the grid, rooms also have to have some area
+	static bool validRects(const LevelRect* rects, uint32_t count, const LevelFileHeader& header, int32_t minSize)
+	{
+		for (uint32_t i = 0; i < count; i++) {
+			const LevelRect& rect = rects[i];
+			if (rect.x < 0 || rect.y < 0 || rect.width < minSize || rect.height < minSize
+				|| int64_t(rect.x) + rect.width > header.gridWidth || int64_t(rect.y) + rect.height > header.gridHeight) return false;
+		}
+		return true;
+	}
+
+public:
+
+	bool open(const std::string& path)
+	{
+		layout = LevelLayout();
+		if (!file.open(path)) return false;
+
+		if (file.getSize() < sizeof(LevelFileHeader)) {
+			file.close();
+			return false;
+		}
+
+		const LevelFileHeader& header = *getArray<LevelFileHeader>(0);
+		const uint64_t tileCount = uint64_t(std::max(header.gridWidth, 0)) * uint64_t(std::max(header.gridHeight, 0));
+
+		bool valid = std::equal(levelFileMagic, levelFileMagic + 4, header.magic) && header.version == levelFileVersion
+			&& header.byteOrder == levelFileByteOrder && header.roomCount > 0 && header.gridWidth > 0 && header.gridHeight > 0
+			&& header.spawnRoom >= 0 && uint32_t(header.spawnRoom) < header.roomCount
+			&& header.bossRoom >= 0 && uint32_t(header.bossRoom) < header.roomCount
+			&& validArray<LevelRect>(header.roomsOffset, header.roomCount)
+			&& validArray<LevelRect>(header.corridorsOffset, header.corridorCount)
+			&& validArray<uint32_t>(header.chestRoomsOffset, header.chestRoomCount)
+			&& validArray<uint8_t>(header.tilesOffset, tileCount)
+			&& validArray<int32_t>(header.roomIdsOffset, tileCount);
+
+		// Renderers, spawning and chests index the grid and the rooms with these without checking again
+		valid = valid && validRects(getArray<LevelRect>(header.roomsOffset), header.roomCount, header, 1)
+			&& validRects(getArray<LevelRect>(header.corridorsOffset), header.corridorCount, header, 0);
+
+		if (valid) {
+			const uint32_t* chestRooms = getArray<uint32_t>(header.chestRoomsOffset);
+			for (uint32_t i = 0; i < header.chestRoomCount && valid; i++) valid = chestRooms[i] < header.roomCount;
+		}
+		if (valid) {
+			const int32_t* roomIds = getArray<int32_t>(header.roomIdsOffset);
+			for (uint64_t i = 0; i < tileCount && valid; i++) valid = roomIds[i] >= -1 && roomIds[i] < int64_t(header.roomCount);
+		}
+
+		if (!valid) {
+			file.close();
+			return false;
+		}
+
+		layout.seed = header.seed;
+		layout.rooms = getArray<LevelRect>(header.roomsOffset);
+		layout.roomCount = header.roomCount;
+		layout.corridors = getArray<LevelRect>(header.corridorsOffset);
+		layout.corridorCount = header.corridorCount;
+		layout.chestRooms = getArray<uint32_t>(header.chestRoomsOffset);
+		layout.chestRoomCount = header.chestRoomCount;
+		layout.spawnRoom = header.spawnRoom;
+		layout.bossRoom = header.bossRoom;
+		layout.tiles = getArray<uint8_t>(header.tilesOffset);
+		layout.roomIds = getArray<int32_t>(header.roomIdsOffset);
+		layout.gridWidth = header.gridWidth;
+		layout.gridHeight = header.gridHeight;
+
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		layout = LevelLayout();
+	}
+
+	bool isOpen() const { return file.getData() != nullptr; }
+
+	// Points into the mapping, valid until the file is closed
+	const LevelLayout& getLayout() const { return layout; }
+};
+
+std::string getPinnedLevelPath(unsigned int level) { return pinnedLevelsDir + "level" + std::to_string(level) + ".lvl"; }
+
+bool writeLevelFile(const std::string& path, const LevelLayout& layout)
+{
+	auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+	const uint64_t tileCount = uint64_t(layout.gridWidth) * uint64_t(layout.gridHeight);
+
+	LevelFileHeader header = {};
+	std::copy(levelFileMagic, levelFileMagic + 4, header.magic);
+	header.version = levelFileVersion;
+	header.byteOrder = levelFileByteOrder;
+	header.seed = layout.seed;
+	header.gridWidth = layout.gridWidth;
+	header.gridHeight = layout.gridHeight;
+	header.roomCount = layout.roomCount;
+	header.corridorCount = layout.corridorCount;
+	header.chestRoomCount = layout.chestRoomCount;
+	header.spawnRoom = layout.spawnRoom;
+	header.bossRoom = layout.bossRoom;
+	header.roomsOffset = align(sizeof(LevelFileHeader));
+	header.corridorsOffset = align(header.roomsOffset + layout.roomCount * sizeof(LevelRect));
+	header.chestRoomsOffset = align(header.corridorsOffset + layout.corridorCount * sizeof(LevelRect));
+	header.tilesOffset = align(header.chestRoomsOffset + layout.chestRoomCount * sizeof(uint32_t));
+	header.roomIdsOffset = align(header.tilesOffset + tileCount);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) return false;
+
+	uint64_t position = 0;
+	auto write = [&](uint64_t offset, const void* data, uint64_t bytes) {
+		static const char padding[8] = {};
+		out.write(padding, offset - position);
+		out.write(static_cast<const char*>(data), bytes);
+		position = offset + bytes;
+	};
+
+	write(0, &header, sizeof(header));
+	write(header.roomsOffset, layout.rooms, layout.roomCount * sizeof(LevelRect));
+	write(header.corridorsOffset, layout.corridors, layout.corridorCount * sizeof(LevelRect));
+	write(header.chestRoomsOffset, layout.chestRooms, layout.chestRoomCount * sizeof(uint32_t));
+	write(header.tilesOffset, layout.tiles, tileCount);
+	write(header.roomIdsOffset, layout.roomIds, tileCount * sizeof(int32_t));
+
+	return bool(out);
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+struct LevelSettings {
+	unsigned int width;
+	unsigned int height;
+	std::string tileset;
+	std::string backgroundTileset;
+	std::string enemiesDir;
+	unsigned int bossHP;
+	float bossMvSpeed;
+};
+
+// False past the last level
+bool getLevelSettings(unsigned int level, LevelSettings& settings)
+{
+	if (level == 1) settings = { dungeon1width, dungeon1height, dungeon1Tileset, background1Tileset, dungeon1EnemiesDir, boss1HP, boss1MvSpeed };
+	else if (level == 2) settings = { dungeon2width, dungeon2height, dungeon2Tileset, background2Tileset, dungeon2EnemiesDir, boss2HP, boss2MvSpeed };
+	else if (level == 3) settings = { dungeon3width, dungeon3height, dungeon3Tileset, background3Tileset, dungeon3EnemiesDir, boss3HP, boss3MvSpeed };
+	else return false;
+
+	return true;
+}
+
+// Everything about a level that can be built away from the main thread: the layout, collision bounds,
+// vertex arrays, the enemy listing and the decoded tilesets. Uploading the tilesets needs the
+// window's OpenGL context, so it is left to the swap, which takes them from the texture cache.
+class PreparedLevel {
+private:
+
+	unsigned int level;
+	LevelSettings settings;
+
+	// Either the generated dungeon or the pinned level file backs the layout
+	BSPDungeon* dungeon;
+	LevelFile levelFile;
+	LevelLayout layout;
+
+	sf::Image tilesetImage;
+	sf::Image backgroundImage;
+
+	// Handed over to the game when the level is entered
+	MapRenderer* mapRenderer;
+	BackgroundRenderer* backgroundRenderer;
+	CollisionController* collisionController;
+	EnemyController* enemyController;
+
+	// Phases of prepare(), reported when the level is entered
+	PhaseTimer timer;
+
+	friend class Game;
+
+public:
+
+	PreparedLevel(unsigned int _level, const LevelSettings& _settings) : level(_level), settings(_settings), dungeon(nullptr), mapRenderer(nullptr), backgroundRenderer(nullptr), collisionController(nullptr), enemyController(nullptr) {}
+
+	PreparedLevel(const PreparedLevel&) = delete;
+	PreparedLevel& operator=(const PreparedLevel&) = delete;
+
+	~PreparedLevel()
+	{
+		delete mapRenderer;
+		delete backgroundRenderer;
+		delete collisionController;
+		delete enemyController;
+		delete dungeon;
+	}
+
+	// Stops early and returns false once cancelled is set
+	bool prepare(uint64_t levelSeed, RandomGenerator* random, AnimationSystem* animations, const AssetDirectory* assets, const TextureCache* textures, ThreadPool* pool, const std::atomic<bool>& cancelled)
+	{
+		timer.restart("level " + std::to_string(level) + " prepared on a worker");
+
+		if (levelFile.open(getPinnedLevelPath(level))) {
+			layout = levelFile.getLayout();
+			timer.mark("level file");
+		}
+		else {
+			dungeon = new BSPDungeon(settings.width, settings.height, levelSeed);
+			dungeon->generate(pool);
+			layout = dungeon->getLayout();
+			timer.mark("generation");
+		}
+		if (cancelled) return false;
+
+		collisionController = new CollisionController;
+		collisionController->load(layout);
+		timer.mark("collision load");
+
+		// The enemies themselves are spawned when the level is entered, their animations with them
+		enemyController = new EnemyController(random, animations);
+		enemyController->loadEnemies(assets->getEnemies(settings.enemiesDir));
+		timer.mark("enemy load");
+		if (cancelled) return false;
+
+		// A missing tileset only leaves the level untextured, as it always has. Tilesets still uploaded
+		// from the last time this dungeon was entered aren't decoded again
+		if (!textures->isResident(settings.tileset)) assets->loadImage(settings.tileset, tilesetImage);
+		if (!textures->isResident(settings.backgroundTileset)) assets->loadImage(settings.backgroundTileset, backgroundImage);
+		timer.mark("tileset decode");
+		if (cancelled) return false;
+
+		// Tile variants come from the same level seed the game reseeds with on entering the level
+		// and the background has a stream of its own, so its pattern doesn't follow the map's
+		const RandomGenerator levelRandom(layout.seed);
+		const uint64_t tileSeed = levelRandom.getStreamSeed(tileStream);
+
+		// The background covers the whole level grid, border included
+		backgroundRenderer = new BackgroundRenderer;
+		backgroundRenderer->build(tileSize, layout.gridWidth, layout.gridHeight, levelRandom.getStreamSeed(backgroundStream), pool);
+		timer.mark("background");
+
+		mapRenderer = new MapRenderer;
+		mapRenderer->build(tileSize, layout, tileSeed, pool);
+		timer.mark("map");
+
+		return !cancelled;
+	}
+
+	unsigned int getLevel() const { return level; }
+
+	const PhaseTimer& getTimer() const { return timer; }
+
+	bool isPinned() const { return levelFile.isOpen(); }
+
+	const LevelLayout& getLayout() const { return layout; }
+};
\ No newline at end of file
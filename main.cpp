@@ -1,10 +1,28 @@
 #include "includer.hpp"
 
-int main()
+int main(int argc, char* argv[])
 {
     sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
 
-    Game game(desktop.width, desktop.height);
+    // Optional arguments: a seed to replay a run, and --endless for the streamed endless dungeon.
+    // --benchmark times the map builds and the enemy updates and exits without opening a window.
+    // --timings <file> appends the startup and level transition timings to the file instead of stderr
+    uint64_t seed = getTimeSeed();
+    bool endless = false;
+    std::string timingPath;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--benchmark") {
+            runMapBenchmark();
+            runEnemyBenchmark();
+            return 0;
+        }
+        if (std::string(argv[i]) == "--endless") endless = true;
+        else if (std::string(argv[i]) == "--timings" && i + 1 < argc) timingPath = argv[++i];
+        else seed = std::stoull(argv[i]);
+    }
+
+    Game game(desktop.width, desktop.height, seed, endless, timingPath);
 
     game.startGame();
 
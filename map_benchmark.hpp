@@ -0,0 +1,180 @@
+#pragma once
+
+// Times building the map and background vertices of every level, at the real size and at ten times
+// the width and height, once serially and once on a worker pool. Started with --benchmark.
+void runMapBenchmark()
+{
+	ThreadPool pool;
+
+	std::cout << "Map build benchmark, " << pool.getThreadCount() << " threads" << std::endl;
+
+	for (unsigned int scale : { 1u, 10u })
+	{
+		for (unsigned int level = 1; level <= 3; level++)
+		{
+			LevelSettings settings;
+			getLevelSettings(level, settings);
+
+			BSPDungeon dungeon(settings.width * scale, settings.height * scale, getLevelSeed(0, level));
+			dungeon.generate(&pool);
+			const LevelLayout& layout = dungeon.getLayout();
+
+			// Best of several runs, each on fresh renderers like a real level load
+			const int runs = scale == 1 ? 20 : 3;
+			double best[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+			std::size_t quads = 0;
+			std::size_t removedQuads = 0;
+
+			for (int run = 0; run < runs; run++) {
+				for (int parallel = 0; parallel < 2; parallel++) {
+					ThreadPool* buildPool = parallel ? &pool : nullptr;
+
+					const auto start = std::chrono::steady_clock::now();
+
+					MapRenderer map;
+					map.build(tileSize, layout, 1, buildPool);
+					BackgroundRenderer background;
+					background.build(tileSize, layout.gridWidth, layout.gridHeight, 1, buildPool);
+
+					best[parallel] = std::min(best[parallel], std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+					quads = map.getQuadCount() + background.getQuadCount();
+					removedQuads = map.getRemovedQuadCount();
+				}
+			}
+
+			std::cout << "Level " << level << " x" << scale << " (" << settings.width * scale << "x" << settings.height * scale << ", "
+				<< layout.roomCount << " rooms, " << quads << " quads, " << removedQuads << " overlapping floor quads removed): serial " << best[0] << " ms, parallel " << best[1] << " ms" << std::endl;
+		}
+	}
+}
+
+// Times one frame of enemy updates, every pass the enemy controller runs, for a growing crowd spread over
+// the rooms of the first level, grown to keep the crowd as dense as the game's, and reports the cost per
+// enemy. Then spawns, plays and kills a level's worth of enemies over and over, and counts what the
+// rounds allocate once the pools have grown. Stand-in frames of enemy size take the place of the assets
+void runEnemyBenchmark()
+{
+	LevelSettings settings;
+	getLevelSettings(1, settings);
+
+	BSPDungeon dungeon(settings.width, settings.height, getLevelSeed(0, 1));
+	dungeon.generate();
+	const LevelLayout& layout = dungeon.getLayout();
+
+	CollisionController collisionController;
+	collisionController.load(layout);
+
+	sf::Image frame;
+	frame.create(16, 20, sf::Color::White);
+
+	TextureAtlas atlas;
+	for (const char* animation : { "benchmark/idle", "benchmark/run" }) {
+		for (int i = 0; i < 4; i++) atlas.add(animation + std::to_string(i) + ".png", frame);
+	}
+	atlas.add("benchmark/weapon.png", frame);
+	atlas.pack();
+
+	AnimationSystem animations(&atlas);
+	const AnimationClip* idleClip = animations.getClip("benchmark/idle", 4, 0.1f);
+	const AnimationClip* runClip = animations.getClip("benchmark/run", 4, 0.1f);
+
+	RandomGenerator random(getLevelSeed(0, 1));
+
+	const LevelRect& spawn = layout.rooms[layout.spawnRoom];
+	PlayerCharacter player(&animations, "benchmark/idle", "benchmark/run", 8, 6);
+	Weapon weapon(&atlas, 1, 1.f, "benchmark/weapon.png");
+	player.equipWeapon(&weapon);
+	player.setPosition(sf::Vector2f((spawn.x + spawn.width / 2) * tileSize.x, (spawn.y + spawn.height / 2) * tileSize.y));
+
+	// At the game's frame rate
+	const float dt = 1.f / defaultFPS;
+
+	std::cout << "Enemy update benchmark" << std::endl;
+
+	for (std::size_t count : { 100u, 1000u, 10000u, 100000u })
+	{
+		// The first level holds about 300 enemies, larger crowds get a level scaled up to hold them as densely
+		const unsigned int scale = (unsigned int)std::ceil(std::sqrt(count / 300.0));
+		BSPDungeon crowdDungeon(settings.width * scale, settings.height * scale, getLevelSeed(0, 1));
+		crowdDungeon.generate();
+		const LevelLayout& crowdLayout = crowdDungeon.getLayout();
+
+		CollisionController crowdCollision;
+		crowdCollision.load(crowdLayout);
+
+		const LevelRect& crowdSpawn = crowdLayout.rooms[crowdLayout.spawnRoom];
+		player.setPosition(sf::Vector2f((crowdSpawn.x + crowdSpawn.width / 2) * tileSize.x, (crowdSpawn.y + crowdSpawn.height / 2) * tileSize.y));
+
+		EnemyStore enemies(&animations);
+		for (std::size_t i = 0; i < count; i++) {
+			const LevelRect& room = crowdLayout.rooms[random.getInRange(spawnStream, 0, crowdLayout.roomCount - 1)];
+			const unsigned int x = random.getInRange(spawnStream, room.x + 1, room.x + room.width - 1) * tileSize.x;
+			const unsigned int y = random.getInRange(spawnStream, room.y + 1, room.y + room.height - 1) * tileSize.y;
+			enemies.add(idleClip, runClip, tier1EnemyMvSpeed, tier1EnemyHP, &random, sf::Vector2f(x, y));
+		}
+
+		// Best frame of several
+		double best = std::numeric_limits<double>::max();
+
+		for (int frame = 0; frame < 50; frame++) {
+			const auto start = std::chrono::steady_clock::now();
+
+			enemies.think(dt, player.getPosition());
+			enemies.integrate(dt);
+			enemies.collide(&crowdCollision);
+			enemies.separate();
+			enemies.touch(&player);
+			enemies.show();
+			animations.update(dt);
+
+			best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		std::cout << count << " enemies, " << crowdLayout.roomCount << " rooms: " << best << " us per frame, " << best * 1000.0 / count << " ns per enemy" << std::endl;
+	}
+
+	player.setPosition(sf::Vector2f((spawn.x + spawn.width / 2) * tileSize.x, (spawn.y + spawn.height / 2) * tileSize.y));
+
+	RenderQueue renderQueue;
+	ItemContainer potions(&atlas, &renderQueue);
+
+	EnemySet enemySet;
+	for (unsigned int tier = 1; tier <= 4; tier++) enemySet.tiers[tier] = "benchmark";
+	enemySet.boss = "benchmark";
+
+	EnemyController enemyController(&random, &animations);
+	enemyController.setRenderQueue(&renderQueue);
+	enemyController.loadEnemies(enemySet);
+
+	const sf::FloatRect level(0.f, 0.f, float(layout.gridWidth * tileSize.x), float(layout.gridHeight * tileSize.y));
+	const int rounds = 24;
+	const int warmupRounds = 8;
+	std::size_t allocations = 0;
+	std::size_t spawned = 0;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		const std::size_t before = getAllocationCount();
+
+		// A few different crowds, repeated
+		RandomGenerator sectorRandom(getLevelSeed(round % 4, 1));
+		enemyController.spawnSectorEnemies(layout, sf::Vector2f(0.f, 0.f), sectorRandom);
+		if (round >= warmupRounds) spawned += enemyController.getEnemyCount();
+
+		for (int frame = 0; frame < 10; frame++) {
+			enemyController.update(dt, &player, &collisionController, &potions);
+			animations.update(dt);
+			renderQueue.update();
+		}
+
+		enemyController.applyDamage(std::numeric_limits<int>::max(), level, &potions);
+		potions.removeOutside(sf::FloatRect());
+		renderQueue.update();
+
+		if (round >= warmupRounds) allocations += getAllocationCount() - before;
+	}
+
+	std::cout << "Spawn and kill, " << rounds - warmupRounds << " rounds after " << warmupRounds << " to grow the pools: " << spawned << " enemies spawned and killed, ";
+	if (allocationsCounted) std::cout << allocations << " allocations" << std::endl;
+	else std::cout << "allocations not counted, build with DUNGEON_COUNT_ALLOCATIONS defined" << std::endl;
+}
\ No newline at end of file
@@ -1,11 +1,139 @@
 #pragma once
 
+// part of a room, corridor or background that lies inside one chunk, with its own range of quads
+struct TilePiece
+{
+    int x, y, width, height;
+    std::size_t firstQuad;
+};
+
+// tile quads bucketed into square chunks, so only the chunks inside the view get drawn
+class TileChunks
+{
+private:
+
+    // every quad in one array, chunk after chunk in row-major order,
+    // chunk k spans vertices [m_chunkStart[k], m_chunkStart[k + 1])
+    std::vector<sf::Vertex> m_vertices;
+    std::vector<std::size_t> m_chunkStart;
+
+    unsigned int m_columns;
+    unsigned int m_rows;
+
+    // size of one chunk in pixels
+    sf::Vector2f m_chunkSize;
+
+public:
+
+    TileChunks() : m_columns(0), m_rows(0) {}
+
+    // first pass: splits the areas along chunk borders, counts the quads of every chunk and allocates them all at once.
+    // width and height of the map are in tiles; with a mask (width x height, row by row) only tiles set in it get a quad
+    void allocate(const unsigned int width, const unsigned int height, const sf::Vector2u tileSize, const std::vector<LevelRect>& areas, std::vector<TilePiece>& pieces, const uint8_t* mask = nullptr)
+    {
+        m_columns = (width + renderChunkSize - 1) / renderChunkSize;
+        m_rows = (height + renderChunkSize - 1) / renderChunkSize;
+        m_chunkSize = sf::Vector2f(float(renderChunkSize * tileSize.x), float(renderChunkSize * tileSize.y));
+
+        std::vector<std::size_t> chunkQuads(m_columns * m_rows, 0);
+        std::vector<unsigned int> pieceChunks;
+
+        pieces.clear();
+        for (const LevelRect& area : areas) {
+            for (int row = area.y / int(renderChunkSize); row * int(renderChunkSize) < area.y + area.height; row++) {
+                for (int column = area.x / int(renderChunkSize); column * int(renderChunkSize) < area.x + area.width; column++) {
+                    int left = std::max(area.x, column * int(renderChunkSize));
+                    int top = std::max(area.y, row * int(renderChunkSize));
+                    int right = std::min(area.x + area.width, (column + 1) * int(renderChunkSize));
+                    int bottom = std::min(area.y + area.height, (row + 1) * int(renderChunkSize));
+
+                    std::size_t quads = std::size_t(right - left) * (bottom - top);
+                    if (mask != nullptr) {
+                        quads = 0;
+                        for (int j = top; j < bottom; j++) {
+                            for (int i = left; i < right; i++) quads += mask[std::size_t(j) * width + i];
+                        }
+                        if (quads == 0) continue;
+                    }
+
+                    unsigned int chunk = row * m_columns + column;
+                    pieces.push_back({ left, top, right - left, bottom - top, chunkQuads[chunk] });
+                    pieceChunks.push_back(chunk);
+                    chunkQuads[chunk] += quads;
+                }
+            }
+        }
+
+        m_chunkStart.assign(m_columns * m_rows + 1, 0);
+        for (unsigned int k = 0; k < m_columns * m_rows; k++) {
+            m_chunkStart[k + 1] = m_chunkStart[k] + chunkQuads[k] * 4;
+        }
+
+        // pieces so far count from the start of their chunk
+        for (std::size_t p = 0; p < pieces.size(); p++) {
+            pieces[p].firstQuad += m_chunkStart[pieceChunks[p]] / 4;
+        }
+
+        m_vertices.assign(m_chunkStart.back(), sf::Vertex());
+    }
+
+    // second pass: fillPiece(piece, quads) writes the quads of one piece, row by row.
+    // pieces never share vertices, so with a pool they are filled in parallel
+    template <class Fill>
+    void fill(const std::vector<TilePiece>& pieces, ThreadPool* pool, Fill fillPiece)
+    {
+        if (pool == nullptr || pool->getThreadCount() < 2) {
+            for (const TilePiece& piece : pieces) fillPiece(piece, &m_vertices[piece.firstQuad * 4]);
+            return;
+        }
+
+        // pieces are dealt out in turn, so big rooms don't all end up in one task
+        const std::size_t taskCount = pool->getThreadCount();
+        std::vector<std::future<void>> tasks;
+        for (std::size_t t = 0; t < taskCount; t++) {
+            tasks.push_back(pool->submit([this, &pieces, &fillPiece, t, taskCount]() {
+                for (std::size_t p = t; p < pieces.size(); p += taskCount) fillPiece(pieces[p], &m_vertices[pieces[p].firstQuad * 4]);
+            }));
+        }
+        for (std::future<void>& task : tasks) pool->wait(task);
+    }
+
+    std::size_t getQuadCount() const { return m_vertices.size() / 4; }
+
+    void draw(sf::RenderTarget& target, const sf::RenderStates& states) const
+    {
+        // the view rectangle in the renderer's own coordinates
+        const sf::View& view = target.getView();
+        const sf::FloatRect visible = states.transform.getInverse().transformRect(sf::FloatRect(view.getCenter() - view.getSize() / 2.f, view.getSize()));
+
+        const int firstColumn = std::max(0, int(std::floor(visible.left / m_chunkSize.x)));
+        const int lastColumn = std::min(int(m_columns) - 1, int(std::floor((visible.left + visible.width) / m_chunkSize.x)));
+        const int firstRow = std::max(0, int(std::floor(visible.top / m_chunkSize.y)));
+        const int lastRow = std::min(int(m_rows) - 1, int(std::floor((visible.top + visible.height) / m_chunkSize.y)));
+
+        if (firstColumn > lastColumn) return;
+
+        // neighbouring chunks of a row are neighbours in memory too, so each row is one draw call
+        for (int row = firstRow; row <= lastRow; row++) {
+            std::size_t first = m_chunkStart[row * m_columns + firstColumn];
+            std::size_t last = m_chunkStart[row * m_columns + lastColumn + 1];
+            if (last > first) target.draw(&m_vertices[first], last - first, sf::Quads, states);
+        }
+    }
+};
+
 class MapRenderer : public sf::Drawable, public sf::Transformable
 {
 private:
 
-    sf::VertexArray m_vertices;
+    TileChunks m_chunks;
     sf::Texture m_tileset;
+    TextureHandle m_handle;
+
+    // either m_tileset or a texture shared between renderers
+    const sf::Texture* m_texture;
+
+    std::size_t m_removedQuads;
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
     {
@@ -13,29 +141,27 @@ private:
         states.transform *= getTransform();
 
         // apply the tileset texture
-        states.texture = &m_tileset;
+        states.texture = m_texture;
 
-        // draw the vertex array
-        target.draw(m_vertices, states);
+        // draw the chunks in view
+        m_chunks.draw(target, states);
     }
 
-    void setTileTexture(sf::Vertex* quad)
+    void setTileTexture(sf::Vertex* quad, int variant) const
     {
-        int random = getRandomInRange(0, 100);
-
-        if (random < 85) {
+        if (variant < 85) {
             quad[0].texCoords = sf::Vector2f(0, 0);
             quad[1].texCoords = sf::Vector2f(16, 0);
             quad[2].texCoords = sf::Vector2f(16, 16);
             quad[3].texCoords = sf::Vector2f(0, 16);
         }
-        else if (random < 90) {
+        else if (variant < 90) {
             quad[0].texCoords = sf::Vector2f(16, 0);
             quad[1].texCoords = sf::Vector2f(32, 0);
             quad[2].texCoords = sf::Vector2f(32, 16);
             quad[3].texCoords = sf::Vector2f(16, 16);
         }
-        else if (random < 95) {
+        else if (variant < 95) {
             quad[0].texCoords = sf::Vector2f(32, 0);
             quad[1].texCoords = sf::Vector2f(48, 0);
             quad[2].texCoords = sf::Vector2f(48, 16);
@@ -51,69 +177,117 @@ private:
 
 public:
 
-    bool load(const std::string& tileset, const sf::Vector2u tileSize, const std::vector<Room*> rooms, const std::vector<Corridor*> corridors)
+    MapRenderer() : m_texture(&m_tileset), m_removedQuads(0) {}
+
+    bool load(const std::string& tileset, const sf::Vector2u tileSize, const LevelLayout& level, uint64_t tileSeed)
     {
         // load the tileset texture
         if (!m_tileset.loadFromFile(tileset)) return false;
 
-        m_vertices.setPrimitiveType(sf::Quads);
-
-        int total_vertex_count = 0;
-        int room_vertex_count = 0;
-
-        // populate the vertex array, with one quad per tile
-        for (const Room* room : rooms) {
+        return load(m_tileset, tileSize, level, tileSeed);
+    }
 
-            room_vertex_count = (room->width * room->height) * 4;
-            total_vertex_count += room_vertex_count;
-            m_vertices.resize(total_vertex_count);
+    // the texture has to outlive the renderer
+    bool load(const sf::Texture& tileset, const sf::Vector2u tileSize, const LevelLayout& level, uint64_t tileSeed)
+    {
+        m_texture = &tileset;
+        build(tileSize, level, tileSeed);
 
-            for (unsigned int i = room->x; i < room->x + room->width; i++) {
-                for (unsigned int j = room->y; j < room->y + room->height; j++) {
+        return true;
+    }
 
-                    sf::Vertex* quad = &m_vertices[(total_vertex_count - room_vertex_count) + (((i - room->x) + (j - room->y) * room->width) * 4)];
+    // a tileset from the texture cache, held for as long as the renderer uses it
+    void setTileset(const TextureHandle& tileset)
+    {
+        m_handle = tileset;
+        m_texture = tileset ? tileset.get() : &m_tileset;
+    }
 
-                    // define its 4 corners
-                    quad[0].position = sf::Vector2f(i * tileSize.x, j * tileSize.y);
-                    quad[1].position = sf::Vector2f((i + 1) * tileSize.x, j * tileSize.y);
-                    quad[2].position = sf::Vector2f((i + 1) * tileSize.x, (j + 1) * tileSize.y);
-                    quad[3].position = sf::Vector2f(i * tileSize.x, (j + 1) * tileSize.y);
+    // vertices only, touches no OpenGL state so it can run on any thread; the pool fills chunks in parallel
+    void build(const sf::Vector2u tileSize, const LevelLayout& level, uint64_t tileSeed, ThreadPool* pool = nullptr)
+    {
+        // map covering the level grid, or every room and corridor when there is no grid
+        int width = level.gridWidth;
+        int height = level.gridHeight;
+        std::size_t rectQuads = 0;
+        for (uint32_t r = 0; r < level.roomCount; r++) {
+            width = std::max(width, level.rooms[r].x + level.rooms[r].width);
+            height = std::max(height, level.rooms[r].y + level.rooms[r].height);
+            rectQuads += std::size_t(level.rooms[r].width) * level.rooms[r].height;
+        }
+        for (uint32_t c = 0; c < level.corridorCount; c++) {
+            width = std::max(width, level.corridors[c].x + level.corridors[c].width);
+            height = std::max(height, level.corridors[c].y + level.corridors[c].height);
+            rectQuads += std::size_t(level.corridors[c].width) * level.corridors[c].height;
+        }
 
-                    setTileTexture(quad);
-                }
+        // corridors overlap the rooms they join, so the floor is the union of both: one quad per walkable tile
+        std::vector<uint8_t> walkable(std::size_t(width) * height, 0);
+        if (level.tiles != nullptr) {
+            for (int j = 0; j < level.gridHeight; j++) {
+                const uint8_t* tiles = &level.tiles[std::size_t(j) * level.gridWidth];
+                uint8_t* row = &walkable[std::size_t(j) * width];
+                for (int i = 0; i < level.gridWidth; i++) row[i] = tiles[i] == floorTile || tiles[i] == corridorTile;
             }
         }
+        else {
+            // endless mode sectors carry no tile grid, so mark their rooms and corridors here
+            auto mark = [&](const LevelRect& area) {
+                for (int j = area.y; j < area.y + area.height; j++) {
+                    std::fill(walkable.begin() + std::size_t(j) * width + area.x, walkable.begin() + std::size_t(j) * width + area.x + area.width, 1);
+                }
+            };
+            for (uint32_t r = 0; r < level.roomCount; r++) mark(level.rooms[r]);
+            for (uint32_t c = 0; c < level.corridorCount; c++) mark(level.corridors[c]);
+        }
 
-        for (const Corridor* corridor : corridors) {
+        std::vector<TilePiece> pieces;
+        m_chunks.allocate(width, height, tileSize, std::vector<LevelRect>(1, { 0, 0, width, height }), pieces, walkable.data());
 
-            room_vertex_count = (corridor->width * corridor->height) * 4;
-            total_vertex_count += room_vertex_count;
-            m_vertices.resize(total_vertex_count);
+        // a level file's grid may hold floor no room or corridor covers, which removes nothing
+        const std::size_t quads = m_chunks.getQuadCount();
+        m_removedQuads = quads > rectQuads ? 0 : rectQuads - quads;
 
-            for (unsigned int i = corridor->x1; i < corridor->x1 + corridor->width; i++) {
-                for (unsigned int j = corridor->y1; j < corridor->y1 + corridor->height; j++) {
-                    sf::Vertex* quad = &m_vertices[(total_vertex_count - room_vertex_count) + (((i - corridor->x1) + (j - corridor->y1) * corridor->width) * 4)];
+        // populate the chunks, with one quad per tile
+        m_chunks.fill(pieces, pool, [this, tileSize, tileSeed, width, &walkable](const TilePiece& piece, sf::Vertex* quad) {
+            // tile variants are a pure function of (seed, x, y), computed a row at a time
+            uint8_t variants[renderChunkSize];
 
+            for (int j = piece.y; j < piece.y + piece.height; j++) {
+                fillTilePercentiles(tileSeed, piece.x, j, piece.width, variants);
+
+                for (int i = piece.x; i < piece.x + piece.width; i++) {
+                    if (!walkable[std::size_t(j) * width + i]) continue;
+
+                    // define its 4 corners
                     quad[0].position = sf::Vector2f(i * tileSize.x, j * tileSize.y);
                     quad[1].position = sf::Vector2f((i + 1) * tileSize.x, j * tileSize.y);
                     quad[2].position = sf::Vector2f((i + 1) * tileSize.x, (j + 1) * tileSize.y);
                     quad[3].position = sf::Vector2f(i * tileSize.x, (j + 1) * tileSize.y);
 
-                    setTileTexture(quad);
+                    setTileTexture(quad, variants[i - piece.x]);
+                    quad += 4;
                 }
             }
-        }
-
-        return true;
+        });
     }
+
+    // quads the rooms and corridors would have had on top of each other
+    std::size_t getRemovedQuadCount() const { return m_removedQuads; }
+
+    std::size_t getQuadCount() const { return m_chunks.getQuadCount(); }
 };
 
 class BackgroundRenderer : public sf::Drawable, public sf::Transformable
 {
 private:
 
-    sf::VertexArray m_vertices;
+    TileChunks m_chunks;
     sf::Texture m_tileset;
+    TextureHandle m_handle;
+
+    // either m_tileset or a texture shared between renderers
+    const sf::Texture* m_texture;
 
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
     {
@@ -121,55 +295,82 @@ private:
         states.transform *= getTransform();
 
         // apply the tileset texture
-        states.texture = &m_tileset;
+        states.texture = m_texture;
 
-        // draw the vertex array
-        target.draw(m_vertices, states);
+        // draw the chunks in view
+        m_chunks.draw(target, states);
     }
 
 public:
 
-    bool load(const std::string& tileset, const sf::Vector2u tileSize, const unsigned int width, const unsigned int height)
+    BackgroundRenderer() : m_texture(&m_tileset) {}
+
+    bool load(const std::string& tileset, const sf::Vector2u tileSize, const unsigned int width, const unsigned int height, uint64_t tileSeed)
     {
         // load the tileset texture
         if (!m_tileset.loadFromFile(tileset)) return false;
 
-        m_vertices.setPrimitiveType(sf::Quads);
+        return load(m_tileset, tileSize, width, height, tileSeed);
+    }
 
-        m_vertices.resize(width * height * 4);
+    // the texture has to outlive the renderer
+    bool load(const sf::Texture& tileset, const sf::Vector2u tileSize, const unsigned int width, const unsigned int height, uint64_t tileSeed)
+    {
+        m_texture = &tileset;
+        build(tileSize, width, height, tileSeed);
 
-        for (unsigned int i = 0; i < width; i++) {
-            for (unsigned int j = 0; j < height; j++) {
-                sf::Vertex* quad = &m_vertices[((i + j * width) * 4)];
+        return true;
+    }
 
-                quad[0].position = sf::Vector2f(i * tileSize.x, j * tileSize.y);
-                quad[1].position = sf::Vector2f((i + 1) * tileSize.x, j * tileSize.y);
-                quad[2].position = sf::Vector2f((i + 1) * tileSize.x, (j + 1) * tileSize.y);
-                quad[3].position = sf::Vector2f(i * tileSize.x, (j + 1) * tileSize.y);
+    // a tileset from the texture cache, held for as long as the renderer uses it
+    void setTileset(const TextureHandle& tileset)
+    {
+        m_handle = tileset;
+        m_texture = tileset ? tileset.get() : &m_tileset;
+    }
 
-                int random = getRandomInRange(0, 100);
+    // vertices only, touches no OpenGL state so it can run on any thread; the pool fills chunks in parallel
+    void build(const sf::Vector2u tileSize, const unsigned int width, const unsigned int height, uint64_t tileSeed, ThreadPool* pool = nullptr)
+    {
+        std::vector<TilePiece> pieces;
+        m_chunks.allocate(width, height, tileSize, std::vector<LevelRect>(1, { 0, 0, int32_t(width), int32_t(height) }), pieces);
 
-                if (random < 85) {
-                    quad[0].texCoords = sf::Vector2f(0, 0);
-                    quad[1].texCoords = sf::Vector2f(16, 0);
-                    quad[2].texCoords = sf::Vector2f(16, 16);
-                    quad[3].texCoords = sf::Vector2f(0, 16);
-                }
-                else if (random < 95) {
-                    quad[0].texCoords = sf::Vector2f(16, 0);
-                    quad[1].texCoords = sf::Vector2f(32, 0);
-                    quad[2].texCoords = sf::Vector2f(32, 16);
-                    quad[3].texCoords = sf::Vector2f(16, 16);
-                }
-                else {
-                    quad[0].texCoords = sf::Vector2f(32, 0);
-                    quad[1].texCoords = sf::Vector2f(48, 0);
-                    quad[2].texCoords = sf::Vector2f(48, 16);
-                    quad[3].texCoords = sf::Vector2f(32, 16);
+        m_chunks.fill(pieces, pool, [tileSize, tileSeed](const TilePiece& piece, sf::Vertex* quad) {
+            uint8_t variants[renderChunkSize];
+
+            for (int j = piece.y; j < piece.y + piece.height; j++) {
+                fillTilePercentiles(tileSeed, piece.x, j, piece.width, variants);
+
+                for (int i = piece.x; i < piece.x + piece.width; i++, quad += 4) {
+                    quad[0].position = sf::Vector2f(i * tileSize.x, j * tileSize.y);
+                    quad[1].position = sf::Vector2f((i + 1) * tileSize.x, j * tileSize.y);
+                    quad[2].position = sf::Vector2f((i + 1) * tileSize.x, (j + 1) * tileSize.y);
+                    quad[3].position = sf::Vector2f(i * tileSize.x, (j + 1) * tileSize.y);
+
+                    int variant = variants[i - piece.x];
+
+                    if (variant < 85) {
+                        quad[0].texCoords = sf::Vector2f(0, 0);
+                        quad[1].texCoords = sf::Vector2f(16, 0);
+                        quad[2].texCoords = sf::Vector2f(16, 16);
+                        quad[3].texCoords = sf::Vector2f(0, 16);
+                    }
+                    else if (variant < 95) {
+                        quad[0].texCoords = sf::Vector2f(16, 0);
+                        quad[1].texCoords = sf::Vector2f(32, 0);
+                        quad[2].texCoords = sf::Vector2f(32, 16);
+                        quad[3].texCoords = sf::Vector2f(16, 16);
+                    }
+                    else {
+                        quad[0].texCoords = sf::Vector2f(32, 0);
+                        quad[1].texCoords = sf::Vector2f(48, 0);
+                        quad[2].texCoords = sf::Vector2f(48, 16);
+                        quad[3].texCoords = sf::Vector2f(32, 16);
+                    }
                 }
             }
-        }
-
-        return true;
+        });
     }
+
+    std::size_t getQuadCount() const { return m_chunks.getQuadCount(); }
 };
\ No newline at end of file
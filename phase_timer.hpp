@@ -0,0 +1,51 @@
+#pragma once
+
+// Wall-clock time of each phase of one transition, such as startup or entering a level, reported together
+// once the transition is over so a hitch can be pinned on a phase and compared between runs
+class PhaseTimer {
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	std::string name;
+	Clock::time_point start;
+	Clock::time_point phaseStart;
+
+	std::vector<std::pair<std::string, double>> phases;
+
+	static double millisecondsBetween(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+public:
+
+	PhaseTimer(const std::string& _name = "") { restart(_name); }
+
+	void restart(const std::string& _name)
+	{
+		name = _name;
+		phases.clear();
+		start = phaseStart = Clock::now();
+	}
+
+	// Ends the phase running since the last mark, or since the start
+	void mark(const std::string& phase)
+	{
+		const Clock::time_point now = Clock::now();
+		phases.push_back({ phase, millisecondsBetween(phaseStart, now) });
+		phaseStart = now;
+	}
+
+	double getTotal() const { return millisecondsBetween(start, phaseStart); }
+
+	const std::string& getName() const { return name; }
+
+	void report(std::ostream& out) const
+	{
+		out << "[timing] " << name << ": " << getTotal() << " ms" << std::endl;
+		for (const auto& phase : phases) {
+			out << "[timing]   " << phase.first << ": " << phase.second << " ms" << std::endl;
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+// Independent random streams, so drawing more numbers in one subsystem
+// (e.g. AI) never shifts the values another subsystem (e.g. layout) gets. New streams go last, so the
+// seeds of the others stay as they were
+enum RandomStream { layoutStream, tileStream, spawnStream, lootStream, aiStream, backgroundStream, randomStreamCount };
+
+uint64_t splitMix64(uint64_t value)
+{
+	value += 0x9E3779B97F4A7C15ull;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+// Unbiased integer in [min, max], identical on every platform for the same engine state
+template <class Engine>
+int getRandomInRange(Engine& engine, int min, int max)
+{
+	if (max <= min) return min;
+
+	const uint64_t range = uint64_t(int64_t(max) - int64_t(min)) + 1;
+	const uint64_t limit = std::numeric_limits<uint64_t>::max() - std::numeric_limits<uint64_t>::max() % range;
+
+	uint64_t value = engine();
+	while (value >= limit) value = engine();
+
+	return int(int64_t(min) + int64_t(value % range));
+}
+
+// Tiny engine for values tied to a key (e.g. one BSP node) rather than to call order
+class SplitMixGenerator {
+private:
+
+	uint64_t state;
+
+public:
+
+	SplitMixGenerator(uint64_t key) : state(key) {}
+
+	uint64_t operator()()
+	{
+		uint64_t value = splitMix64(state);
+		state += 0x9E3779B97F4A7C15ull;
+		return value;
+	}
+
+	int getInRange(int min, int max) { return getRandomInRange(*this, min, max); }
+};
+
+class RandomGenerator {
+private:
+
+	uint64_t seed;
+
+	std::mt19937_64 streams[randomStreamCount];
+
+public:
+
+	RandomGenerator(uint64_t _seed = 0) { setSeed(_seed); }
+
+	void setSeed(uint64_t _seed)
+	{
+		seed = _seed;
+
+		// Every stream gets its own seed derived from the master seed
+		for (unsigned int i = 0; i < randomStreamCount; i++) {
+			streams[i].seed(getStreamSeed(i));
+		}
+	}
+
+	uint64_t getSeed() const { return seed; }
+
+	uint64_t getStreamSeed(unsigned int stream) const { return splitMix64(seed ^ splitMix64(stream + 1)); }
+
+	int getInRange(RandomStream stream, int min, int max) { return getRandomInRange(streams[stream], min, max); }
+};
+
+// Seed for a fresh game when none was requested explicitly
+uint64_t getTimeSeed()
+{
+	return splitMix64(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+}
+
+// Stateless per-tile value in [0, 100], the same in any order and on any thread
+uint8_t getTilePercentile(uint64_t seed, int x, int y)
+{
+	uint64_t hash = splitMix64(seed ^ (uint64_t(uint32_t(y)) << 32) ^ uint32_t(x));
+	return uint8_t(((hash >> 32) * 101) >> 32);
+}
+
+// Bulk version for a run of tiles in one row, hashes the row once instead of per tile
+void fillTilePercentiles(uint64_t seed, int x, int y, unsigned int count, uint8_t* percentiles)
+{
+	const uint64_t rowKey = seed ^ (uint64_t(uint32_t(y)) << 32);
+
+	for (unsigned int i = 0; i < count; i++) {
+		uint64_t hash = splitMix64(rowKey ^ uint32_t(x + int(i)));
+		percentiles[i] = uint8_t(((hash >> 32) * 101) >> 32);
+	}
+}
+
+// Every level of a run is reproducible from the run seed and the level number
+uint64_t getLevelSeed(uint64_t gameSeed, unsigned int level)
+{
+	return splitMix64(gameSeed + splitMix64(level));
+}
\ No newline at end of file
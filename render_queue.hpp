@@ -0,0 +1,158 @@
+#pragma once
+
+class RenderQueue;
+
+// what one entity puts in the render queue. lives inside the entity, so the queue only holds pointers
+// and the entity leaves the queue by itself when it is destroyed
+class RenderNode
+{
+private:
+
+    const sf::Sprite* m_sprite;
+
+    // drawn right after the sprite, e.g. the weapon in a character's hand
+    const sf::Sprite* m_attached;
+
+    // drawn above every sprite, e.g. an enemy's health bar
+    const sf::RectangleShape* m_overlay;
+    bool m_overlayVisible;
+
+    // bottom edge of the sprite, deeper nodes are drawn later
+    float m_key;
+
+    RenderQueue* m_queue;
+    std::size_t m_index;
+
+    friend class RenderQueue;
+
+public:
+
+    RenderNode(const sf::Sprite* sprite) : m_sprite(sprite), m_attached(nullptr), m_overlay(nullptr), m_overlayVisible(false), m_key(0.f), m_queue(nullptr), m_index(0) {}
+
+    // an entity's node points into the entity itself, a copy would point into the wrong one
+    RenderNode(const RenderNode&) = delete;
+    RenderNode& operator=(const RenderNode&) = delete;
+
+    ~RenderNode();
+
+    void attach(const sf::Sprite* sprite) { m_attached = sprite; }
+
+    void setOverlay(const sf::RectangleShape* overlay) { m_overlay = overlay; }
+
+    void showOverlay(bool visible) { m_overlayVisible = visible; }
+
+    bool isQueued() const { return m_queue != nullptr; }
+
+    // for nodes that outlive their entity, e.g. in a pool
+    void leaveQueue();
+};
+
+// every dynamic entity in the world, kept sorted by the y of its feet so nearer entities cover farther ones.
+// the order barely changes between frames, so an insertion sort over last frame's order is close to linear,
+// and nothing is allocated or copied once the queue has grown to the scene
+class RenderQueue
+{
+private:
+
+    // sorted after update(); removed nodes leave a null until the next update
+    std::vector<RenderNode*> m_nodes;
+
+    std::size_t m_removed;
+    std::size_t m_added;
+
+    static float getKey(const RenderNode& node)
+    {
+        const sf::FloatRect bounds = node.m_sprite->getGlobalBounds();
+        return bounds.top + bounds.height;
+    }
+
+public:
+
+    RenderQueue() : m_removed(0), m_added(0) {}
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    ~RenderQueue()
+    {
+        for (RenderNode* node : m_nodes) {
+            if (node != nullptr) node->m_queue = nullptr;
+        }
+    }
+
+    // sorted in on the next update
+    void add(RenderNode& node)
+    {
+        if (node.m_queue == this) return;
+        if (node.m_queue != nullptr) node.m_queue->remove(node);
+
+        node.m_queue = this;
+        node.m_index = m_nodes.size();
+        m_nodes.push_back(&node);
+        m_added++;
+    }
+
+    void remove(RenderNode& node)
+    {
+        if (node.m_queue != this) return;
+
+        m_nodes[node.m_index] = nullptr;
+        node.m_queue = nullptr;
+        m_removed++;
+    }
+
+    // drops removed nodes, refreshes every key and restores the order
+    void update()
+    {
+        if (m_removed > 0) {
+            m_nodes.erase(std::remove(m_nodes.begin(), m_nodes.end(), nullptr), m_nodes.end());
+            m_removed = 0;
+        }
+
+        for (RenderNode* node : m_nodes) node->m_key = getKey(*node);
+
+        // a whole level spawning at once is cheaper to sort from scratch. ties keep last frame's order, new
+        // nodes come after the old ones in the order they were added; unlike std::stable_sort this needs
+        // no buffer, so a crowd spawning mid-game allocates nothing
+        if (m_added > renderQueueResortCount) {
+            std::sort(m_nodes.begin(), m_nodes.end(), [](const RenderNode* a, const RenderNode* b) { return a->m_key < b->m_key || (a->m_key == b->m_key && a->m_index < b->m_index); });
+        }
+        else {
+            for (std::size_t i = 1; i < m_nodes.size(); i++) {
+                RenderNode* node = m_nodes[i];
+                std::size_t j = i;
+                for (; j > 0 && m_nodes[j - 1]->m_key > node->m_key; j--) m_nodes[j] = m_nodes[j - 1];
+                m_nodes[j] = node;
+            }
+        }
+        m_added = 0;
+
+        for (std::size_t i = 0; i < m_nodes.size(); i++) m_nodes[i]->m_index = i;
+    }
+
+    // back to front, then the overlays on top
+    void draw(SpriteBatch& batch) const
+    {
+        for (const RenderNode* node : m_nodes) {
+            if (node == nullptr) continue;
+            batch.add(*node->m_sprite);
+            if (node->m_attached != nullptr) batch.add(*node->m_attached);
+        }
+
+        for (const RenderNode* node : m_nodes) {
+            if (node != nullptr && node->m_overlay != nullptr && node->m_overlayVisible) batch.add(*node->m_overlay);
+        }
+    }
+
+    std::size_t getSize() const { return m_nodes.size() - m_removed; }
+};
+
+void RenderNode::leaveQueue()
+{
+    if (m_queue != nullptr) m_queue->remove(*this);
+}
+
+RenderNode::~RenderNode()
+{
+    leaveQueue();
+}
\ No newline at end of file
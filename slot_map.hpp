@@ -0,0 +1,172 @@
+#pragma once
+
+// names one element of a slot map for as long as it lives. the generation tells a removed element
+// from whatever took its slot later, so a stale handle finds nothing instead of the wrong element
+struct SlotHandle
+{
+    uint32_t slot;
+    uint32_t generation;
+
+    SlotHandle() : slot(std::numeric_limits<uint32_t>::max()), generation(0) {}
+    SlotHandle(uint32_t _slot, uint32_t _generation) : slot(_slot), generation(_generation) {}
+
+    bool operator==(const SlotHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// the bookkeeping of a slot map without the elements, for owners that keep their elements in arrays of
+// their own, e.g. one per component. elements stay dense in positions 0..size()-1; removing one moves the
+// last element into its position, and the owner moves its own arrays the same way
+class SlotIndex
+{
+private:
+
+    struct Slot
+    {
+        uint32_t position;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+
+    // slot of the element at each position
+    std::vector<uint32_t> m_owners;
+
+public:
+
+    static const std::size_t npos = std::size_t(-1);
+
+    // handle of a new element at position size()
+    SlotHandle add()
+    {
+        uint32_t slot = uint32_t(m_slots.size());
+        if (!m_freeSlots.empty()) {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        }
+        else m_slots.push_back(Slot{ 0, 0 });
+
+        m_slots[slot].position = uint32_t(m_owners.size());
+        m_owners.push_back(slot);
+        return SlotHandle(slot, m_slots[slot].generation);
+    }
+
+    // the last element takes the removed one's position; every handle of the removed one goes stale
+    void remove(std::size_t position)
+    {
+        const uint32_t slot = m_owners[position];
+        m_slots[slot].generation++;
+        m_freeSlots.push_back(slot);
+
+        m_owners[position] = m_owners.back();
+        m_slots[m_owners[position]].position = uint32_t(position);
+        m_owners.pop_back();
+    }
+
+    void clear()
+    {
+        for (uint32_t slot : m_owners) {
+            m_slots[slot].generation++;
+            m_freeSlots.push_back(slot);
+        }
+        m_owners.clear();
+    }
+
+    // position of the handle's element, npos once it was removed
+    std::size_t find(const SlotHandle& handle) const
+    {
+        if (handle.slot >= m_slots.size() || m_slots[handle.slot].generation != handle.generation) return npos;
+        return m_slots[handle.slot].position;
+    }
+
+    SlotHandle getHandle(std::size_t position) const
+    {
+        const uint32_t slot = m_owners[position];
+        return SlotHandle(slot, m_slots[slot].generation);
+    }
+
+    std::size_t size() const { return m_owners.size(); }
+};
+
+// elements reached by handle in O(1), added and removed in O(1), and iterated as one dense array.
+// removing moves the last element into the hole, so the order of iteration is not the order of insertion
+template <typename T>
+class SlotMap
+{
+private:
+
+    SlotIndex m_index;
+    std::vector<T> m_values;
+
+public:
+
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    SlotHandle insert(const T& value)
+    {
+        m_values.push_back(value);
+        return m_index.add();
+    }
+
+    // position is that of the element while iterating
+    void eraseAt(std::size_t position)
+    {
+        m_values[position] = m_values.back();
+        m_values.pop_back();
+        m_index.remove(position);
+    }
+
+    bool erase(const SlotHandle& handle)
+    {
+        const std::size_t position = m_index.find(handle);
+        if (position == SlotIndex::npos) return false;
+
+        eraseAt(position);
+        return true;
+    }
+
+    // removes every element the predicate holds for, in one sweep
+    template <typename Predicate>
+    std::size_t eraseIf(Predicate predicate)
+    {
+        std::size_t erased = 0;
+        for (std::size_t i = 0; i < m_values.size();) {
+            if (predicate(m_values[i])) {
+                eraseAt(i);
+                erased++;
+            }
+            else i++;
+        }
+        return erased;
+    }
+
+    void clear()
+    {
+        m_values.clear();
+        m_index.clear();
+    }
+
+    // nullptr once the element was removed
+    T* get(const SlotHandle& handle)
+    {
+        const std::size_t position = m_index.find(handle);
+        return position != SlotIndex::npos ? &m_values[position] : nullptr;
+    }
+
+    bool contains(const SlotHandle& handle) const { return m_index.find(handle) != SlotIndex::npos; }
+
+    SlotHandle getHandle(std::size_t position) const { return m_index.getHandle(position); }
+
+    T& operator[](std::size_t position) { return m_values[position]; }
+    const T& operator[](std::size_t position) const { return m_values[position]; }
+
+    std::size_t size() const { return m_values.size(); }
+    bool empty() const { return m_values.empty(); }
+
+    iterator begin() { return m_values.begin(); }
+    iterator end() { return m_values.end(); }
+    const_iterator begin() const { return m_values.begin(); }
+    const_iterator end() const { return m_values.end(); }
+};
\ No newline at end of file
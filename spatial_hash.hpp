@@ -0,0 +1,134 @@
+#pragma once
+
+// points sorted into a uniform grid of square cells, for finding the ones near an area without looking
+// at all of them. cells are hashed into a power of two of buckets, so the grid has no bounds and endless
+// mode sectors left of or above the origin need nothing special. rebuilt from scratch whenever the points
+// move, which is a counting sort: two passes over the points and one over the buckets, and no allocations
+// once the arrays have grown to the largest crowd
+class SpatialHash
+{
+private:
+
+    float m_inverseCellSize;
+
+    uint32_t m_bucketMask;
+
+    // points of bucket b are m_entries[m_bucketStarts[b]] up to m_entries[m_bucketStarts[b + 1]], with a
+    // copy of each point alongside, so a query reads the points it visits one after the other
+    std::vector<uint32_t> m_bucketStarts;
+    std::vector<uint32_t> m_entries;
+    std::vector<sf::Vector2f> m_points;
+    std::vector<uint32_t> m_pointBuckets;
+
+    // a query visits each bucket once even where several of its cells hash to the same bucket, by
+    // stamping the buckets it has visited
+    mutable std::vector<uint32_t> m_bucketStamps;
+    mutable uint32_t m_stamp;
+
+    int32_t getCellCoordinate(float value) const
+    {
+        const float cell = value * m_inverseCellSize;
+        const int32_t truncated = int32_t(cell);
+        return cell < float(truncated) ? truncated - 1 : truncated;
+    }
+
+    // cell left of or above the edge, for the far edges of an area, which a cell starting there does not overlap
+    int32_t getCellBefore(float value) const
+    {
+        const float cell = value * m_inverseCellSize;
+        const int32_t truncated = int32_t(cell);
+        return cell > float(truncated) ? truncated : truncated - 1;
+    }
+
+    uint32_t getBucket(int32_t x, int32_t y) const
+    {
+        return ((uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u)) & m_bucketMask;
+    }
+
+public:
+
+    explicit SpatialHash(float cellSize) : m_inverseCellSize(1.f / cellSize), m_bucketMask(0), m_stamp(0) {}
+
+    void build(const std::vector<sf::Vector2f>& points)
+    {
+        // about two buckets per point keeps collisions between cells rare
+        uint32_t bucketCount = 64;
+        while (bucketCount < points.size() * 2) bucketCount *= 2;
+
+        if (bucketCount != m_bucketStamps.size()) {
+            m_bucketStamps.assign(bucketCount, 0);
+            m_stamp = 0;
+        }
+        m_bucketMask = bucketCount - 1;
+
+        m_bucketStarts.assign(bucketCount + 1, 0);
+        m_pointBuckets.resize(points.size());
+        m_entries.resize(points.size());
+        m_points.resize(points.size());
+
+        for (std::size_t i = 0; i < points.size(); i++) {
+            const uint32_t bucket = getBucket(getCellCoordinate(points[i].x), getCellCoordinate(points[i].y));
+            m_pointBuckets[i] = bucket;
+            m_bucketStarts[bucket + 1]++;
+        }
+
+        for (uint32_t bucket = 0; bucket < bucketCount; bucket++) m_bucketStarts[bucket + 1] += m_bucketStarts[bucket];
+
+        // fills each bucket from its start, which leaves every start at the next bucket's, then puts them back
+        for (std::size_t i = 0; i < points.size(); i++) {
+            const uint32_t entry = m_bucketStarts[m_pointBuckets[i]]++;
+            m_entries[entry] = uint32_t(i);
+            m_points[entry] = points[i];
+        }
+
+        for (uint32_t bucket = bucketCount; bucket > 0; bucket--) m_bucketStarts[bucket] = m_bucketStarts[bucket - 1];
+        m_bucketStarts[0] = 0;
+    }
+
+    // calls visit with the index and position of every point in the cells the area overlaps, each once. the area's right
+    // and bottom edges are not part of it. points of other cells sharing a bucket come along too, so visit
+    // tests what it needs itself
+    template <typename Visit>
+    void query(const sf::FloatRect& area, Visit visit) const
+    {
+        if (m_entries.empty()) return;
+
+        // an area wider than the buckets would visit every bucket anyway
+        const float cellsAcross = area.width * m_inverseCellSize + 2.f;
+        const float cellsDown = area.height * m_inverseCellSize + 2.f;
+        if (cellsAcross * cellsDown >= float(m_bucketStamps.size())) {
+            forEach(visit);
+            return;
+        }
+
+        if (++m_stamp == 0) {
+            std::fill(m_bucketStamps.begin(), m_bucketStamps.end(), 0);
+            m_stamp = 1;
+        }
+
+        const int32_t left = getCellCoordinate(area.left);
+        const int32_t top = getCellCoordinate(area.top);
+        const int32_t right = std::max(getCellBefore(area.left + area.width), left);
+        const int32_t bottom = std::max(getCellBefore(area.top + area.height), top);
+
+        for (int32_t y = top; y <= bottom; y++) {
+            for (int32_t x = left; x <= right; x++) {
+                const uint32_t bucket = getBucket(x, y);
+                if (m_bucketStamps[bucket] == m_stamp) continue;
+                m_bucketStamps[bucket] = m_stamp;
+
+                for (uint32_t i = m_bucketStarts[bucket]; i < m_bucketStarts[bucket + 1]; i++) visit(m_entries[i], m_points[i]);
+            }
+        }
+    }
+
+    // calls visit with the index and position of every point, bucket by bucket. points of a cell come one after the
+    // other, so queries around them in turn find the same buckets in the cache
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        for (std::size_t i = 0; i < m_entries.size(); i++) visit(m_entries[i], m_points[i]);
+    }
+
+    std::size_t size() const { return m_entries.size(); }
+};
\ No newline at end of file
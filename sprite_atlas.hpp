@@ -0,0 +1,386 @@
+#pragma once
+
+// where one image ended up: the atlas page and its pixels on that page
+struct AtlasRegion
+{
+    unsigned int page;
+    sf::IntRect rect;
+};
+
+class AssetBundle;
+
+// packs the small images of characters, weapons, items and chests into a few large textures at load time,
+// so sprites sharing a page can be drawn together. read-only once built, lookups are safe from any thread
+class TextureAtlas
+{
+private:
+
+    // images waiting for pack(), in the order they were added. the ones added by path stay empty until decode()
+    std::vector<sf::Image> m_images;
+    std::vector<std::string> m_pendingPaths;
+
+    // packed pages waiting for upload()
+    std::vector<sf::Image> m_pageImages;
+
+    std::map<std::string, unsigned int> m_regionIds;
+    std::vector<AtlasRegion> m_regions;
+    std::vector<sf::Texture*> m_pages;
+
+    // "idle0.png", "idle1.png", ... are the frames of the animation "idle", as region ids in frame order
+    std::map<std::string, std::vector<unsigned int>> m_animations;
+
+    // untextured quads (health bars) sample the middle of this white block
+    unsigned int m_whiteRegion;
+
+    // regions of images that failed to load, or are asked for but never added, are empty
+    AtlasRegion m_emptyRegion;
+
+    // frame tables from the names of the added images, each one stopping at its first missing frame
+    void findAnimations()
+    {
+        std::map<std::string, std::map<unsigned int, unsigned int>> frames;
+
+        for (const auto& entry : m_regionIds)
+        {
+            const std::string& key = entry.first;
+            if (key.size() < 5 || key.compare(key.size() - 4, 4, ".png") != 0) continue;
+
+            std::size_t digits = key.size() - 4;
+            while (digits > 0 && std::isdigit((unsigned char)key[digits - 1])) digits--;
+            if (digits == key.size() - 4 || key.size() - 4 - digits > 4) continue;
+
+            frames[key.substr(0, digits)][std::stoul(key.substr(digits, key.size() - 4 - digits))] = entry.second;
+        }
+
+        m_animations.clear();
+        for (const auto& entry : frames)
+        {
+            std::vector<unsigned int>& table = m_animations[entry.first];
+            for (unsigned int i = 0; entry.second.count(i) != 0; i++) table.push_back(entry.second.at(i));
+            if (table.empty()) m_animations.erase(entry.first);
+        }
+    }
+
+    void clearPages()
+    {
+        for (sf::Texture* page : m_pages) delete page;
+        m_pages.clear();
+    }
+
+public:
+
+    TextureAtlas() : m_whiteRegion(0), m_emptyRegion({ 0, sf::IntRect() })
+    {
+        sf::Image white;
+        white.create(4, 4, sf::Color::White);
+        m_whiteRegion = m_regions.size();
+        m_regions.push_back(m_emptyRegion);
+        m_images.push_back(white);
+        m_pendingPaths.push_back(std::string());
+    }
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    ~TextureAtlas()
+    {
+        clearPages();
+    }
+
+    // only queues the file, decode() reads it
+    void add(const std::string& path)
+    {
+        const std::string key = getAssetKey(path);
+        if (m_regionIds.count(key) != 0) return;
+
+        m_regionIds[key] = m_regions.size();
+        m_regions.push_back(m_emptyRegion);
+        m_images.push_back(sf::Image());
+        m_pendingPaths.push_back(path);
+    }
+
+    // an image made at load time rather than read from a file, e.g. a glyph rasterised from a font
+    void add(const std::string& path, const sf::Image& image)
+    {
+        const std::string key = getAssetKey(path);
+        if (m_regionIds.count(key) != 0) return;
+
+        m_regionIds[key] = m_regions.size();
+        m_regions.push_back(m_emptyRegion);
+        m_images.push_back(image);
+        m_pendingPaths.push_back(std::string());
+    }
+
+    // decodes the queued files, spread over the pool's threads when there is one. progress is called on this
+    // thread with the images decoded so far while the workers run, so it can keep a loading screen drawn.
+    // a file that fails to decode is dropped, as if it had never been added
+    bool decode(ThreadPool* pool = nullptr, const std::function<void(std::size_t, std::size_t)>& progress = nullptr)
+    {
+        std::vector<unsigned int> pending;
+        for (unsigned int i = 0; i < m_pendingPaths.size(); i++) {
+            if (!m_pendingPaths[i].empty()) pending.push_back(i);
+        }
+        if (pending.empty()) return true;
+
+        std::atomic<std::size_t> next(0);
+        std::atomic<std::size_t> decoded(0);
+        std::vector<char> loaded(m_images.size(), 0);
+
+        auto decodePending = [this, &pending, &next, &decoded, &loaded]() {
+            for (std::size_t p = next++; p < pending.size(); p = next++) {
+                const unsigned int i = pending[p];
+                loaded[i] = m_images[i].loadFromFile(m_pendingPaths[i]);
+                decoded++;
+            }
+        };
+
+        if (pool == nullptr) {
+            decodePending();
+        }
+        else {
+            std::vector<std::future<void>> tasks;
+            for (unsigned int t = 0; t < pool->getThreadCount(); t++) tasks.push_back(pool->submit(decodePending));
+
+            if (progress) {
+                while (decoded < pending.size()) {
+                    progress(decoded, pending.size());
+                    tasks.back().wait_for(std::chrono::milliseconds(10));
+                }
+            }
+            for (std::future<void>& task : tasks) pool->wait(task);
+        }
+        if (progress) progress(pending.size(), pending.size());
+
+        bool decodedAll = true;
+        for (unsigned int i : pending)
+        {
+            if (!loaded[i]) {
+                m_regionIds.erase(getAssetKey(m_pendingPaths[i]));
+                decodedAll = false;
+            }
+            m_pendingPaths[i].clear();
+        }
+        return decodedAll;
+    }
+
+    // every png below the directory
+    void addDirectory(const std::string& directoryPath)
+    {
+        if (!fs::is_directory(directoryPath)) return;
+
+        for (const auto& entry : fs::recursive_directory_iterator(directoryPath))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".png") add(entry.path().string());
+        }
+    }
+
+    // shelf-packs the added images, tallest first, into pages of atlasPageSize. needs no window,
+    // the asset packer stops here and writes the pages out
+    void pack()
+    {
+        // whatever decode() wasn't called for is read here, on this thread
+        decode();
+
+        const unsigned int pageSize = std::min(atlasPageSize, sf::Texture::getMaximumSize());
+
+        std::vector<unsigned int> order(m_images.size());
+        for (unsigned int i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return m_images[a].getSize().y > m_images[b].getSize().y; });
+
+        // one pixel of padding keeps neighbours from bleeding in when sprites land between pixels
+        unsigned int page = 0, x = 0, y = 0, shelfHeight = 0;
+        std::vector<unsigned int> pageHeights(1, 0);
+
+        for (unsigned int i : order)
+        {
+            const sf::Vector2u size = m_images[i].getSize();
+            if (size.x == 0 || size.y == 0) continue;
+
+            if (size.x + 1 > pageSize || size.y + 1 > pageSize) {
+                std::cerr << "Image of " << size.x << "x" << size.y << " does not fit an atlas page" << std::endl;
+                continue;
+            }
+
+            if (x + size.x + 1 > pageSize) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (y + size.y + 1 > pageSize) {
+                page++;
+                x = y = shelfHeight = 0;
+                pageHeights.push_back(0);
+            }
+
+            m_regions[i] = { page, sf::IntRect(x, y, size.x, size.y) };
+
+            x += size.x + 1;
+            shelfHeight = std::max(shelfHeight, size.y + 1);
+            pageHeights[page] = std::max(pageHeights[page], y + shelfHeight);
+        }
+
+        m_pageImages.assign(pageHeights.size(), sf::Image());
+        for (unsigned int i = 0; i < pageHeights.size(); i++)
+        {
+            m_pageImages[i].create(pageSize, std::max(pageHeights[i], 1u), sf::Color::Transparent);
+
+            for (unsigned int j = 0; j < m_regions.size(); j++) {
+                const AtlasRegion& region = m_regions[j];
+                if (region.page == i && region.rect.width > 0) m_pageImages[i].copy(m_images[j], region.rect.left, region.rect.top);
+            }
+        }
+
+        m_images.clear();
+        m_images.shrink_to_fit();
+        m_pendingPaths.clear();
+
+        findAnimations();
+    }
+
+    // turns the packed pages into textures, needs the window's OpenGL context
+    bool upload()
+    {
+        clearPages();
+
+        bool uploaded = true;
+        for (const sf::Image& pageImage : m_pageImages)
+        {
+            sf::Texture* texture = new sf::Texture;
+            uploaded = texture->loadFromImage(pageImage) && uploaded;
+            m_pages.push_back(texture);
+        }
+
+        m_pageImages.clear();
+        m_pageImages.shrink_to_fit();
+
+        return uploaded;
+    }
+
+    bool build()
+    {
+        pack();
+        return upload();
+    }
+
+    // pages, regions and frame tables straight from a bundle written by the asset packer, see asset_bundle.hpp
+    bool load(const AssetBundle& bundle);
+
+    const AtlasRegion& getRegion(const std::string& path) const
+    {
+        auto it = m_regionIds.find(getAssetKey(path));
+        return it == m_regionIds.end() ? m_emptyRegion : m_regions[it->second];
+    }
+
+    // frames of the animation whose images are named prefix0.png, prefix1.png, ...
+    std::vector<AtlasRegion> getAnimation(const std::string& prefix) const
+    {
+        std::vector<AtlasRegion> frames;
+
+        auto it = m_animations.find(getAssetKey(prefix));
+        if (it == m_animations.end()) return frames;
+
+        for (unsigned int id : it->second) frames.push_back(m_regions[id]);
+        return frames;
+    }
+
+    const AtlasRegion& getWhiteRegion() const { return m_regions[m_whiteRegion]; }
+
+    const sf::Texture& getPage(unsigned int page) const { return *m_pages[page]; }
+
+    unsigned int getPageCount() const { return m_pages.size(); }
+
+    // what the asset packer writes out
+    const std::vector<sf::Image>& getPageImages() const { return m_pageImages; }
+    const std::map<std::string, unsigned int>& getRegionIds() const { return m_regionIds; }
+    const std::vector<AtlasRegion>& getRegions() const { return m_regions; }
+    const std::map<std::string, std::vector<unsigned int>>& getAnimations() const { return m_animations; }
+
+    // points the sprite at the region, leaving its origin and transform alone
+    void apply(sf::Sprite& sprite, const AtlasRegion& region) const
+    {
+        if (region.page < m_pages.size()) sprite.setTexture(*m_pages[region.page]);
+        sprite.setTextureRect(region.rect);
+    }
+};
+
+// the dynamic sprites of one frame in a single vertex array. consecutive sprites on the same atlas page
+// share a draw call, so the number of calls depends on the pages used, not on how many sprites there are
+class SpriteBatch : public sf::Drawable
+{
+private:
+
+    struct Run
+    {
+        const sf::Texture* texture;
+        std::size_t firstVertex;
+        std::size_t vertexCount;
+    };
+
+    const TextureAtlas* m_atlas;
+
+    // cleared every frame but never shrunk, so a steady scene allocates nothing
+    std::vector<sf::Vertex> m_vertices;
+    std::vector<Run> m_runs;
+
+    void addQuad(const sf::Texture* texture, const sf::Transform& transform, const sf::FloatRect& local, const sf::FloatRect& texCoords, const sf::Color& color)
+    {
+        if (m_runs.empty() || m_runs.back().texture != texture) m_runs.push_back({ texture, m_vertices.size(), 0 });
+        m_runs.back().vertexCount += 4;
+
+        const float right = local.left + local.width;
+        const float bottom = local.top + local.height;
+        const float u = texCoords.left + texCoords.width;
+        const float v = texCoords.top + texCoords.height;
+
+        m_vertices.push_back(sf::Vertex(transform.transformPoint(sf::Vector2f(local.left, local.top)), color, sf::Vector2f(texCoords.left, texCoords.top)));
+        m_vertices.push_back(sf::Vertex(transform.transformPoint(sf::Vector2f(right, local.top)), color, sf::Vector2f(u, texCoords.top)));
+        m_vertices.push_back(sf::Vertex(transform.transformPoint(sf::Vector2f(right, bottom)), color, sf::Vector2f(u, v)));
+        m_vertices.push_back(sf::Vertex(transform.transformPoint(sf::Vector2f(local.left, bottom)), color, sf::Vector2f(texCoords.left, v)));
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        for (const Run& run : m_runs) {
+            states.texture = run.texture;
+            target.draw(&m_vertices[run.firstVertex], run.vertexCount, sf::Quads, states);
+        }
+    }
+
+public:
+
+    SpriteBatch(const TextureAtlas* atlas) : m_atlas(atlas) {}
+
+    void clear()
+    {
+        m_vertices.clear();
+        m_runs.clear();
+    }
+
+    // same quad sf::Sprite would draw, flips and rotation included
+    void add(const sf::Sprite& sprite)
+    {
+        const sf::IntRect rect = sprite.getTextureRect();
+        if (rect.width == 0 || rect.height == 0) return;
+
+        const sf::FloatRect local(0.f, 0.f, float(std::abs(rect.width)), float(std::abs(rect.height)));
+        const sf::FloatRect texCoords(float(rect.left), float(rect.top), float(rect.width), float(rect.height));
+
+        addQuad(sprite.getTexture(), sprite.getTransform(), local, texCoords, sprite.getColor());
+    }
+
+    // filled with the shape's colour from the atlas' white block
+    void add(const sf::RectangleShape& shape)
+    {
+        const AtlasRegion& white = m_atlas->getWhiteRegion();
+        if (white.page >= m_atlas->getPageCount()) return;
+
+        const sf::Vector2f size = shape.getSize();
+        const sf::FloatRect texCoords(white.rect.left + 1.f, white.rect.top + 1.f, white.rect.width - 2.f, white.rect.height - 2.f);
+
+        addQuad(&m_atlas->getPage(white.page), shape.getTransform(), sf::FloatRect(0.f, 0.f, size.x, size.y), texCoords, shape.getFillColor());
+    }
+
+    std::size_t getSpriteCount() const { return m_vertices.size() / 4; }
+
+    std::size_t getDrawCallCount() const { return m_runs.size(); }
+};
\ No newline at end of file
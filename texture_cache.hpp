@@ -0,0 +1,209 @@
+#pragma once
+
+// "./assets//a/../b.png" and "assets/b.png" are the same asset
+std::string getAssetKey(const std::string& path)
+{
+    return fs::path(path).lexically_normal().generic_string();
+}
+
+class TextureCache;
+
+// one uploaded texture and everything the cache keeps about it
+struct TextureCacheEntry
+{
+    sf::Texture texture;
+    std::string key;
+
+    // textures of tier 0 are never evicted; levels put their tilesets in the tier of their dungeon
+    unsigned int tier;
+
+    unsigned int references;
+    std::size_t bytes;
+
+    // evicted while still in use, freed with the last handle
+    bool evicted;
+};
+
+// shared ownership of a cached texture. copying a handle adds a reference, destroying it drops one
+class TextureHandle
+{
+private:
+
+    TextureCache* m_cache;
+    TextureCacheEntry* m_entry;
+
+    friend class TextureCache;
+
+    TextureHandle(TextureCache* cache, TextureCacheEntry* entry) : m_cache(cache), m_entry(entry) {}
+
+    void release();
+
+public:
+
+    TextureHandle() : m_cache(nullptr), m_entry(nullptr) {}
+
+    TextureHandle(const TextureHandle& other);
+    TextureHandle& operator=(const TextureHandle& other);
+
+    ~TextureHandle() { release(); }
+
+    // nullptr for an empty handle, e.g. when the texture failed to load
+    const sf::Texture* get() const { return m_entry != nullptr ? &m_entry->texture : nullptr; }
+
+    explicit operator bool() const { return m_entry != nullptr; }
+};
+
+// one copy of each large texture, keyed by asset path, shared by whoever asks for it. textures nobody holds
+// stay resident so entering the same dungeon again uploads nothing, until their tier is evicted.
+// lookups and counters are safe from any thread, uploads only from the one owning the window
+class TextureCache
+{
+private:
+
+    std::map<std::string, TextureCacheEntry*> m_entries;
+    mutable std::mutex m_mutex;
+
+    std::size_t m_hits;
+    std::size_t m_misses;
+    std::size_t m_residentBytes;
+
+    friend class TextureHandle;
+
+    // called with the mutex held
+    void erase(TextureCacheEntry* entry)
+    {
+        m_residentBytes -= entry->bytes;
+        delete entry;
+    }
+
+    void addReference(TextureCacheEntry* entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->references++;
+    }
+
+    void release(TextureCacheEntry* entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--entry->references == 0 && entry->evicted) erase(entry);
+    }
+
+public:
+
+    TextureCache() : m_hits(0), m_misses(0), m_residentBytes(0) {}
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // every handle has to be gone by now
+    ~TextureCache()
+    {
+        for (auto& entry : m_entries) delete entry.second;
+    }
+
+    // the cached texture, or the one decode() fills in uploaded and cached. an empty handle if decoding or the upload fails
+    TextureHandle load(const std::string& path, unsigned int tier, const std::function<bool(sf::Image&)>& decode)
+    {
+        const std::string key = getAssetKey(path);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto it = m_entries.find(key);
+            if (it != m_entries.end()) {
+                m_hits++;
+                it->second->references++;
+                return TextureHandle(this, it->second);
+            }
+            m_misses++;
+        }
+
+        sf::Image image;
+        if (!decode(image) || image.getSize().x == 0) return TextureHandle();
+
+        TextureCacheEntry* entry = new TextureCacheEntry;
+        if (!entry->texture.loadFromImage(image)) {
+            delete entry;
+            return TextureHandle();
+        }
+        entry->key = key;
+        entry->tier = tier;
+        entry->references = 1;
+        entry->bytes = std::size_t(image.getSize().x) * image.getSize().y * 4;
+        entry->evicted = false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[key] = entry;
+        m_residentBytes += entry->bytes;
+        return TextureHandle(this, entry);
+    }
+
+    // whether load() would hit, so a level being prepared can skip decoding what is already uploaded
+    bool isResident(const std::string& path) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.count(getAssetKey(path)) != 0;
+    }
+
+    // drops the textures of the tier; ones still held are freed when their last handle goes
+    void evict(unsigned int tier)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            TextureCacheEntry* entry = it->second;
+            if (entry->tier != tier || tier == 0) {
+                ++it;
+                continue;
+            }
+
+            it = m_entries.erase(it);
+            if (entry->references == 0) erase(entry);
+            else entry->evicted = true;
+        }
+    }
+
+    // entering a dungeon evicts the tiers of all the others
+    void evictAllBut(unsigned int tier)
+    {
+        std::vector<unsigned int> tiers;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& entry : m_entries) {
+                if (entry.second->tier != tier) tiers.push_back(entry.second->tier);
+            }
+        }
+        for (unsigned int other : tiers) evict(other);
+    }
+
+    std::size_t getHitCount() const { std::lock_guard<std::mutex> lock(m_mutex); return m_hits; }
+    std::size_t getMissCount() const { std::lock_guard<std::mutex> lock(m_mutex); return m_misses; }
+
+    // bytes of every texture still uploaded, held or not
+    std::size_t getResidentBytes() const { std::lock_guard<std::mutex> lock(m_mutex); return m_residentBytes; }
+
+    std::size_t getTextureCount() const { std::lock_guard<std::mutex> lock(m_mutex); return m_entries.size(); }
+};
+
+TextureHandle::TextureHandle(const TextureHandle& other) : m_cache(other.m_cache), m_entry(other.m_entry)
+{
+    if (m_entry != nullptr) m_cache->addReference(m_entry);
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+{
+    if (other.m_entry != nullptr) other.m_cache->addReference(other.m_entry);
+    release();
+
+    m_cache = other.m_cache;
+    m_entry = other.m_entry;
+    return *this;
+}
+
+void TextureHandle::release()
+{
+    if (m_entry != nullptr) m_cache->release(m_entry);
+    m_cache = nullptr;
+    m_entry = nullptr;
+}
\ No newline at end of file
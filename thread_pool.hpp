@@ -0,0 +1,143 @@
+#pragma once
+
+// Tasks belong to a group: the one of the task that submitted them, or group 0 when submitted from outside
+// the pool, except background jobs, which start a group of their own. A thread waiting for a future only
+// helps with tasks of its own group, so waiting on a few tile chunks never runs a whole background job
+class ThreadPool {
+private:
+
+	struct Task {
+		std::function<void()> function;
+		uint32_t group;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Task> tasks;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	bool stopping;
+
+	// Group of the task the calling thread is running, shared by every pool so groups never mix
+	static uint32_t& getCurrentGroup()
+	{
+		thread_local uint32_t group = 0;
+		return group;
+	}
+
+	static uint32_t startGroup()
+	{
+		static std::atomic<uint32_t> lastGroup(0);
+		return ++lastGroup;
+	}
+
+	static void run(Task& task)
+	{
+		uint32_t& current = getCurrentGroup();
+		const uint32_t outer = current;
+
+		current = task.group;
+		task.function();
+		current = outer;
+	}
+
+	void workerLoop()
+	{
+		while (true)
+		{
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+				if (stopping && tasks.empty()) return;
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			run(task);
+		}
+	}
+
+	// Runs the oldest queued task of the calling thread's group, if there is one
+	bool runPendingTask()
+	{
+		const uint32_t group = getCurrentGroup();
+
+		Task task;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto found = std::find_if(tasks.begin(), tasks.end(), [group](const Task& queued) { return queued.group == group; });
+			if (found == tasks.end()) return false;
+
+			task = std::move(*found);
+			tasks.erase(found);
+		}
+		run(task);
+		return true;
+	}
+
+	template <class Function>
+	auto enqueue(Function function, uint32_t group) -> std::future<decltype(function())>
+	{
+		auto task = std::make_shared<std::packaged_task<decltype(function())()>>(std::move(function));
+		std::future<decltype(function())> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(Task{ [task]() { (*task)(); }, group });
+		}
+		condition.notify_one();
+		return result;
+	}
+
+public:
+
+	ThreadPool(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency())) : stopping(false)
+	{
+		for (unsigned int i = 0; i < threadCount; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	unsigned int getThreadCount() const { return workers.size(); }
+
+	// The task joins the group of the caller
+	template <class Function>
+	auto submit(Function function) -> std::future<decltype(function())>
+	{
+		return enqueue(std::move(function), getCurrentGroup());
+	}
+
+	// For long jobs running beside the game, e.g. preparing the next level. The job and everything it
+	// submits make up a group of their own, only workers and the job's own waits run them
+	template <class Function>
+	auto submitBackground(Function function) -> std::future<decltype(function())>
+	{
+		return enqueue(std::move(function), startGroup());
+	}
+
+	// Runs queued tasks of the caller's group while waiting, so tasks that fork and wait on subtasks can't
+	// deadlock the pool, and a wait never picks up unrelated work
+	template <class T>
+	T wait(std::future<T>& future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!runPendingTask()) future.wait_for(std::chrono::microseconds(100));
+		}
+		return future.get();
+	}
+};
\ No newline at end of file
@@ -5,13 +5,23 @@ enum GameState { gameLoop, gameEndWin, gameEndLost, exitMenu };
 class Game {
 private:
 
+	// Declared first so startup is timed from before the window opens. Startup, restarts and level changes
+	// each end with the first frame drawn after them, when their phases are written to the timing log
+	PhaseTimer transitionTimer;
+	bool timingPending;
+	std::ofstream timingFile;
+	std::ostream* timingLog;
+
 	sf::RenderWindow window;
 	sf::View view;
 
-	BSPDungeon* currentDungeon;
+	PreparedLevel* activeLevel;
 	MapRenderer* mapRenderer;
 	BackgroundRenderer* backgroundRenderer;
 
+	bool endlessMode;
+	EndlessDungeon* endlessDungeon;
+
 	PlayerCharacter* playerCharacter;
 
 	CollisionController* collisionController;
@@ -23,37 +33,86 @@ private:
 	ChestContainer* chestContainer;
 	ItemContainer* potionContainer;
 
+	// Mapped for the whole run when asset_packer has written it, the directory and atlas point into it
+	AssetBundle assetBundle;
+	AssetDirectory assetDirectory;
+
+	// Every dynamic sprite is drawn from the atlas through the batch, in the order of the render queue
+	TextureAtlas* spriteAtlas;
+	SpriteBatch* spriteBatch;
+	RenderQueue renderQueue;
+
+	// Shared animation clips and the playback state of every animated sprite
+	AnimationSystem* animationSystem;
+
+	// Level tilesets, kept uploaded while their dungeon is played
+	TextureCache textureCache;
+
 	EndGameScreen* endGameScreen;
-	PotionStatus* potionStatus;
+	PlayerHud* playerHud;
 
 	sf::Clock frameClock;
 
+	uint64_t gameSeed;
+	RandomGenerator random;
+
 	bool generateLevel;
 	unsigned int currentLevel;
 
 	GameState gameState;
 
+	// The next level is prepared here while the current one is played
+	ThreadPool workerPool;
+	std::future<PreparedLevel*> nextLevel;
+	std::atomic<bool> cancelPrefetch;
+
+	void savePinnedLevel()
+	{
+		// The level being played was loaded from its pinned file, which is still mapped
+		if (endlessMode || activeLevel == nullptr || activeLevel->isPinned()) return;
+
+		std::string path = getPinnedLevelPath(activeLevel->getLevel());
+		fs::create_directories(pinnedLevelsDir);
+
+		if (writeLevelFile(path, activeLevel->getLayout())) std::cout << "Level saved to " << path << std::endl;
+		else std::cerr << "Failed to save level to " << path << std::endl;
+	}
+
 public:
 
-	Game(unsigned int window_width, unsigned int window_height) :
-		window(sf::VideoMode(window_width, window_height), "SFML Window", sf::Style::Fullscreen), view(sf::Vector2f(0.f, 0.f), sf::Vector2f(cameraSizeX, cameraSizeY)),
-		currentDungeon(nullptr), mapRenderer(nullptr), backgroundRenderer(nullptr), playerCharacter(nullptr), collisionController(nullptr), enemyController(nullptr), weaponPool(nullptr), endGameScreen(nullptr)
+	// Timings go to stderr unless a file is given, which they are appended to
+	Game(unsigned int window_width, unsigned int window_height, uint64_t seed, bool endless = false, const std::string& timingPath = "") :
+		transitionTimer("startup"), timingPending(true), timingLog(&std::cerr), window(sf::VideoMode(window_width, window_height), "SFML Window", sf::Style::Fullscreen), view(sf::Vector2f(0.f, 0.f), sf::Vector2f(cameraSizeX, cameraSizeY)),
+		activeLevel(nullptr), mapRenderer(nullptr), backgroundRenderer(nullptr), endlessMode(endless), endlessDungeon(nullptr), playerCharacter(nullptr), collisionController(nullptr), enemyController(nullptr), weaponPool(nullptr), weaponsOnGround(nullptr), chestContainer(nullptr), potionContainer(nullptr), spriteAtlas(nullptr), spriteBatch(nullptr), animationSystem(nullptr), endGameScreen(nullptr), gameSeed(seed), cancelPrefetch(false)
 	{
+		if (!timingPath.empty()) {
+			timingFile.open(timingPath, std::ios::app);
+			if (timingFile) timingLog = &timingFile;
+			else std::cerr << "Failed to open " << timingPath << ", timings go to stderr" << std::endl;
+		}
+
 		window.setFramerateLimit(defaultFPS);
 		window.setView(view);
+		transitionTimer.mark("window");
+
+		loadAssets();
 
 		endGameScreen = new EndGameScreen(window);
 
-		potionStatus = new PotionStatus(window);
+		playerHud = new PlayerHud(spriteAtlas);
+		transitionTimer.mark("screens and HUD");
 
-		restartGame();
+		restartGame(gameSeed);
 	}
 
 	~Game()
 	{
-		delete currentDungeon;
+		stopPrefetch();
+
+		delete activeLevel;
 		delete mapRenderer;
 		delete backgroundRenderer;
+		delete endlessDungeon;
 		delete playerCharacter;
 		delete collisionController;
 		delete enemyController;
@@ -62,102 +121,222 @@ public:
 		delete weaponsOnGround;
 		delete chestContainer;
 		delete potionContainer;
-		delete potionStatus;
+		delete playerHud;
+		delete animationSystem;
+		delete spriteBatch;
+		delete spriteAtlas;
 	}
 
-	void generateDungeon(unsigned int width, unsigned int height, std::string enemyTexturePath, unsigned int bossHP, float bossMvSpeed)
+	// Everything levels and spawns look up later: the listing of the asset directories and the sprite atlas.
+	// Without a bundle of this version the directories are walked and the images decoded and packed here.
+	// Whether the bundle still matches the assets is asset_packer --check's job, startup touches no asset files
+	void loadAssets()
 	{
-		delete currentDungeon;
-		currentDungeon = new BSPDungeon(width, height);
-		currentDungeon->generate();
+		spriteAtlas = new TextureAtlas;
 
-		delete collisionController;
-		collisionController = new CollisionController;
-		collisionController->load(currentDungeon->getRooms(), currentDungeon->getCorridors());
+		if (assetBundle.open(assetBundlePath) && spriteAtlas->load(assetBundle) && assetDirectory.load(assetBundle)) {
+			std::cout << "Assets loaded from " << assetBundlePath << std::endl;
+			transitionTimer.mark("asset bundle");
+		}
+		else {
+			assetBundle.close();
 
-		delete enemyController;
-		enemyController = new EnemyController;
-		enemyController->loadEnemies(enemyTexturePath);
-		enemyController->spawnEnemies(currentDungeon->getRooms(), currentDungeon->getBossRoom(), currentDungeon->getSpawnRoom(), bossHP, bossMvSpeed);
+			delete spriteAtlas;
+			spriteAtlas = new TextureAtlas;
+			addSpriteDirectories(*spriteAtlas);
+
+			// The PNGs are decoded on every worker while this thread keeps the loading screen drawn,
+			// only packing and the upload are left to it
+			LoadingScreen loadingScreen(window);
+			spriteAtlas->decode(&workerPool, [this, &loadingScreen](std::size_t done, std::size_t total) { loadingScreen.render(view, done, total); });
+			transitionTimer.mark("sprite decode");
+
+			if (!spriteAtlas->build()) std::cerr << "Failed to upload the sprite atlas" << std::endl;
+			transitionTimer.mark("atlas pack and upload");
+
+			assetDirectory.scan();
+			transitionTimer.mark("asset directory scan");
+		}
+
+		spriteBatch = new SpriteBatch(spriteAtlas);
+		animationSystem = new AnimationSystem(spriteAtlas);
+	}
+
+	// Nullptr past the last level, or when the level couldn't be loaded or the prefetch was cancelled
+	PreparedLevel* prepareLevel(unsigned int level)
+	{
+		LevelSettings settings;
+		if (!getLevelSettings(level, settings)) return nullptr;
+
+		PreparedLevel* prepared = new PreparedLevel(level, settings);
+		if (!prepared->prepare(getLevelSeed(gameSeed, level), &random, animationSystem, &assetDirectory, &textureCache, &workerPool, cancelPrefetch)) {
+			delete prepared;
+			return nullptr;
+		}
+		return prepared;
+	}
+
+	void prefetchLevel(unsigned int level)
+	{
+		cancelPrefetch = false;
+		nextLevel = workerPool.submitBackground([this, level]() { return prepareLevel(level); });
+	}
+
+	// Waits for the prefetch if it is still running
+	PreparedLevel* takePrefetchedLevel()
+	{
+		if (!nextLevel.valid()) return nullptr;
+		return workerPool.wait(nextLevel);
+	}
+
+	void stopPrefetch()
+	{
+		cancelPrefetch = true;
+		delete takePrefetchedLevel();
+		cancelPrefetch = false;
+	}
+
+	// The cached tileset; on a miss it is uploaded from the image decoded with the level, or decoded here
+	TextureHandle loadTileset(const std::string& path, unsigned int tier, const sf::Image& decoded = sf::Image())
+	{
+		return textureCache.load(path, tier, [&](sf::Image& image) {
+			if (decoded.getSize().x != 0) {
+				image = decoded;
+				return true;
+			}
+			return assetDirectory.loadImage(path, image);
+		});
+	}
+
+	// Phases are added to a transition already being timed, startup's first level is part of startup
+	void beginTransition(const std::string& name)
+	{
+		if (timingPending) return;
+
+		transitionTimer.restart(name);
+		timingPending = true;
+	}
+
+	// Swaps in a prepared level, leaving only texture uploads and entity spawning to this thread
+	void enterLevel(PreparedLevel* level)
+	{
+		// Every subsystem of the level draws from streams of the same level seed
+		random.setSeed(level->layout.seed);
+
+		std::swap(collisionController, level->collisionController);
+		std::swap(enemyController, level->enemyController);
+		std::swap(mapRenderer, level->mapRenderer);
+		std::swap(backgroundRenderer, level->backgroundRenderer);
+
+		enemyController->setRenderQueue(&renderQueue);
+		transitionTimer.mark("swap");
+
+		mapRenderer->setTileset(loadTileset(level->settings.tileset, level->getLevel(), level->tilesetImage));
+		backgroundRenderer->setTileset(loadTileset(level->settings.backgroundTileset, level->getLevel(), level->backgroundImage));
+		transitionTimer.mark("tileset upload");
+
+		std::cout << "Level " << level->getLevel() << ": " << mapRenderer->getQuadCount() << " floor quads, " << mapRenderer->getRemovedQuadCount() << " overlapping quads removed" << std::endl;
+
+		enemyController->spawnEnemies(level->layout, level->settings.bossHP, level->settings.bossMvSpeed);
+		transitionTimer.mark("enemy spawn");
 
 		weaponsOnGround->passWeaponsToAnotherContainer(weaponPool);
 
-		chestContainer->spawnChests(currentDungeon->getChestRooms());
+		chestContainer->spawnChests(level->layout);
 
 		potionContainer->reset();
 
-		playerCharacter->setPosition(currentDungeon->getStartingPosition());
+		playerCharacter->setPosition(level->layout.getStartingPosition());
+		transitionTimer.mark("chests and items");
+
+		// The previous level now holds the replaced controllers and renderers
+		delete activeLevel;
+		activeLevel = level;
+
+		delete level->collisionController;
+		delete level->enemyController;
+		delete level->mapRenderer;
+		delete level->backgroundRenderer;
+		level->collisionController = nullptr;
+		level->enemyController = nullptr;
+		level->mapRenderer = nullptr;
+		level->backgroundRenderer = nullptr;
+		transitionTimer.mark("previous level release");
+
+		// Nothing draws the other dungeons' tilesets any more
+		textureCache.evictAllBut(level->getLevel());
+		transitionTimer.mark("texture eviction");
+
+		// Prepared away from this thread, usually while the previous level was played
+		level->getTimer().report(*timingLog);
+
+		std::cout << "Texture cache: " << textureCache.getTextureCount() << " textures, " << textureCache.getResidentBytes() / 1024 << " KiB resident, "
+			<< textureCache.getHitCount() << " hits, " << textureCache.getMissCount() << " misses" << std::endl;
 	}
 
-	void createMap(std::string dungeonTileset, std::string background1Tileset, sf::Vector2u tileSize, unsigned int backgroundWidth, unsigned int backgroundHeight)
+	void startEndlessRun()
 	{
-		delete backgroundRenderer;
-		backgroundRenderer = new BackgroundRenderer;
-		backgroundRenderer->load(background1Tileset, tileSize, backgroundWidth, backgroundHeight);
+		delete collisionController;
+		collisionController = new CollisionController;
 
-		delete mapRenderer;
-		mapRenderer = new MapRenderer;
-		mapRenderer->load(dungeonTileset, tileSize, currentDungeon->getRooms(), currentDungeon->getCorridors());
+		delete enemyController;
+		enemyController = new EnemyController(&random, animationSystem);
+		enemyController->setRenderQueue(&renderQueue);
+		enemyController->loadEnemies(assetDirectory.getEnemies(dungeon1EnemiesDir));
+
+		delete endlessDungeon;
+		endlessDungeon = new EndlessDungeon(getLevelSeed(gameSeed, 1));
+		textureCache.evictAllBut(1);
+		endlessDungeon->setTilesets(loadTileset(dungeon1Tileset, 1), loadTileset(background1Tileset, 1));
+		endlessDungeon->start(playerCharacter, collisionController, enemyController, potionContainer);
+		transitionTimer.mark("endless dungeon");
 	}
 
 	void createPlayer(std::string idleAnimPath, std::string runAnimPath, unsigned int mv_speed, unsigned int HP)
 	{
 		delete playerCharacter;
-		playerCharacter = new PlayerCharacter(idleAnimPath, runAnimPath, mv_speed, HP);
-		playerCharacter->equipWeapon(weaponPool->getRandomWeapon());
+		playerCharacter = new PlayerCharacter(animationSystem, idleAnimPath, runAnimPath, mv_speed, HP);
+		playerCharacter->equipWeapon(weaponPool->getRandomWeapon(&random));
+		renderQueue.add(playerCharacter->getRenderNode());
 	}
 
 	void drawSprites()
 	{
-		window.draw(*backgroundRenderer);
-		window.draw(*mapRenderer);
-
-		std::vector<sf::Sprite> chestSprites = chestContainer->getChestSprites();
-		for (sf::Sprite& sprite : chestSprites) {
-			window.draw(sprite);
+		if (endlessMode) {
+			endlessDungeon->draw(window, view);
 		}
-		
-		std::vector<sf::Sprite> weaponSprites = weaponsOnGround->getWeaponSprites();
-		for (sf::Sprite& sprite : weaponSprites) {
-			window.draw(sprite);
+		else {
+			window.draw(*backgroundRenderer);
+			window.draw(*mapRenderer);
 		}
 
-		std::vector<sf::Sprite> potionSprites = potionContainer->getSprites();
-		for (sf::Sprite& sprite : potionSprites) {
-			window.draw(sprite);
-		}
+		// Entities further down the screen cover the ones above them, health bars stay on top
+		renderQueue.update();
 
-		std::vector<sf::Sprite> enemySprites = enemyController->getEnemySprites();
-		for (sf::Sprite& sprite : enemySprites) {
-			window.draw(sprite);
-		}
+		spriteBatch->clear();
+		renderQueue.draw(*spriteBatch);
 
-		std::vector<sf::RectangleShape> enemyHealthbars = enemyController->getEnemyHealthbars();
-		for (sf::RectangleShape& rect : enemyHealthbars) {
-			window.draw(rect);
-		}
+		// One draw call per atlas page in use, however many sprites there are
+		window.draw(*spriteBatch);
 
-		window.draw(playerCharacter->getSprite());
-		window.draw(playerCharacter->getWeaponSprite());
-		window.draw(playerCharacter->getHealthbar());
-		
-		potionStatus->render(view, playerCharacter);
+		playerHud->update(view, playerCharacter);
+		window.draw(*playerHud);
 	}
 
 	void updateModules(const float& dt)
 	{
-		sf::Vector2f healthBarPosition = view.getCenter() - view.getSize() / 2.f;
-		healthBarPosition.x += 10.f;
-		healthBarPosition.y += 10.f;
-		playerCharacter->update(dt, healthBarPosition);
+		playerCharacter->update(dt);
 		collisionController->update(playerCharacter);
 
-		chestContainer->update(dt, playerCharacter);
+		chestContainer->update(playerCharacter);
 		weaponsOnGround->update(playerCharacter);
 
 		potionContainer->update(playerCharacter);
 
 		enemyController->update(dt, playerCharacter, collisionController, potionContainer);
+
+		// Every animation in the game advances here, after the entities picked what to play
+		animationSystem->update(dt);
 	}
 
 	void gameStateUpdater() 
@@ -169,50 +348,79 @@ public:
 			return;
 		}
 
+		// Endless mode has no levels, only sectors streamed in as the player moves
+		if (endlessMode) {
+			endlessDungeon->update(playerCharacter, collisionController, enemyController, potionContainer);
+			return;
+		}
+
 		if (enemyController != nullptr && enemyController->bossDefeated()) generateLevel = true;
 
-		if (generateLevel || currentDungeon == nullptr) {
-			if (currentLevel == 1) {
-				generateDungeon(dungeon1width, dungeon1height, dungeon1EnemiesDir, boss1HP, boss1MvSpeed);
-				createMap(dungeon1Tileset, background1Tileset, tileSize, dungeon1width + 40, dungeon1height + 40);
-			}
-			else if (currentLevel == 2) {
-				generateDungeon(dungeon2width, dungeon2height, dungeon2EnemiesDir, boss2HP, boss2MvSpeed);
-				createMap(dungeon2Tileset, background2Tileset, tileSize, dungeon2width + 40, dungeon2height + 40);
-			}
-			else if (currentLevel == 3) {
-				generateDungeon(dungeon3width, dungeon3height, dungeon3EnemiesDir, boss3HP, boss3MvSpeed);
-				createMap(dungeon3Tileset, background3Tileset, tileSize, dungeon3width + 40, dungeon3height + 40);
+		if (generateLevel) {
+			beginTransition("level " + std::to_string(currentLevel));
+
+			// Normally prefetched during the previous level; prepared here only if that failed
+			PreparedLevel* level = takePrefetchedLevel();
+			transitionTimer.mark("wait for prefetch");
+			if (level == nullptr || level->getLevel() != currentLevel) {
+				delete level;
+				level = prepareLevel(currentLevel);
+				transitionTimer.mark("prepare on main thread");
 			}
-			else {
+
+			if (level == nullptr) {
 				gameState = gameEndWin;
 				return;
 			}
+
+			enterLevel(level);
+
 			currentLevel++;
 			generateLevel = false;
+
+			prefetchLevel(currentLevel);
 		}
 	}
 
-	void restartGame()
+	void restartGame(uint64_t seed)
 	{
+		beginTransition("restart");
+
+		// A level prefetched for the previous run is of no use
+		stopPrefetch();
+		transitionTimer.mark("cancel prefetch");
+
 		generateLevel = true;
 		currentLevel = 1;
 		gameState = gameLoop;
 
-		delete weaponPool;
-		weaponPool = new WeaponContainer;
-		weaponPool->load(weaponsDir);
-
-		delete weaponsOnGround;
-		weaponsOnGround = new WeaponContainer;
-
-		delete chestContainer;
-		chestContainer = new ChestContainer(weaponPool, weaponsOnGround);
+		gameSeed = seed;
+		random.setSeed(getLevelSeed(gameSeed, 0));
+		std::cout << "Game seed: " << gameSeed << std::endl;
+
+		// Weapons and potions of the last run are handed out again rather than loaded anew
+		if (weaponPool == nullptr) {
+			weaponPool = new WeaponContainer;
+			weaponPool->load(spriteAtlas, assetDirectory.getWeapons());
+			weaponsOnGround = new WeaponContainer(&renderQueue);
+			chestContainer = new ChestContainer(weaponPool, weaponsOnGround, &random, animationSystem, &renderQueue);
+			potionContainer = new ItemContainer(spriteAtlas, &renderQueue);
+		}
+		else {
+			chestContainer->reset();
+			weaponsOnGround->passWeaponsToAnotherContainer(weaponPool);
+			if (playerCharacter != nullptr) weaponPool->addWeapon(playerCharacter->unequipWeapon());
+			weaponPool->restoreLoadOrder();
+			potionContainer->reset();
+		}
 
-		delete potionContainer;
-		potionContainer = new ItemContainer;
+		transitionTimer.mark("weapons and containers");
 
 		createPlayer(knightIdleAnim, knightRunAnim, 8, 6);
+		transitionTimer.mark("player");
+
+		if (endlessMode) startEndlessRun();
+		else prefetchLevel(currentLevel);
 	}
 
 	void renderGame(const float& dt)
@@ -231,7 +439,7 @@ public:
 			endGameScreen->render(view);
 			if (endGameScreen->handleInput())
 			{
-				restartGame();
+				restartGame(splitMix64(gameSeed));
 			}
 		}
 		else if (gameState == gameEndWin) 
@@ -240,7 +448,7 @@ public:
 			endGameScreen->render(view);
 			if (endGameScreen->handleInput())
 			{
-				restartGame();
+				restartGame(splitMix64(gameSeed));
 			}
 		}
 		else if (gameState == exitMenu)
@@ -270,6 +478,10 @@ public:
 				if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape) {
 					if (gameState == gameLoop) gameState = exitMenu;
 				}
+
+				if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F5) {
+					if (gameState == gameLoop) savePinnedLevel();
+				}
 			}
 
 			gameStateUpdater();
@@ -282,6 +494,12 @@ public:
 			renderGame(dt);
 
 			window.display();
+
+			if (timingPending) {
+				transitionTimer.mark("first frame");
+				transitionTimer.report(*timingLog);
+				timingPending = false;
+			}
 		}
 	}
 };
\ No newline at end of file
@@ -9,7 +9,7 @@ private:
 	float attack_cooldown;
 
 	sf::Sprite sprite;
-    sf::Texture texture;
+    RenderNode renderNode;
 
     float elapsedAnimationTime = 0.0f;
     bool animationComplete = false;
@@ -19,17 +19,19 @@ private:
 
     float length;
 
+    // Place in the weapon list, restored when a new run takes every weapon back
+    unsigned int loadOrder;
+
 public:
 
-    Weapon(unsigned int _damage, float _attack_cooldown, std::string _weaponTexturePath) : damage(_damage), attack_cooldown(_attack_cooldown)
+    Weapon(const TextureAtlas* atlas, unsigned int _damage, float _attack_cooldown, std::string _weaponTexturePath, unsigned int _loadOrder = 0) : damage(_damage), attack_cooldown(_attack_cooldown), renderNode(&sprite), loadOrder(_loadOrder)
     {
-        // Load textures for idle animation
-        texture.loadFromFile(_weaponTexturePath);
-
-        sprite.setTexture(texture);
+        // Texture comes from the sprite atlas
+        const AtlasRegion& region = atlas->getRegion(_weaponTexturePath);
+        atlas->apply(sprite, region);
 
         // Set sprite's origin to it's center on x axis
-        sf::Vector2f spriteSize(texture.getSize().x, texture.getSize().y);
+        sf::Vector2f spriteSize(region.rect.width, region.rect.height);
         sprite.setOrigin(sf::Vector2f(spriteSize.x * 0.5f, spriteSize.y));
 
         length = sprite.getGlobalBounds().height;
@@ -42,6 +44,8 @@ public:
 
     sf::Sprite& getSprite() { return sprite; }
 
+    RenderNode& getRenderNode() { return renderNode; }
+
     sf::FloatRect getBounds() { return sprite.getGlobalBounds(); }
 
     unsigned int getDamage() const { return damage; }
@@ -61,6 +65,17 @@ public:
         elapsedAnimationTime = 0.0f;
     }
 
+    // Back to how it was loaded, for a weapon handed out again in a new run
+    void resetPose()
+    {
+        resetAnim();
+        targetRotation = 80.0f;
+        sprite.setRotation(originalRotation);
+        sprite.setScale(1.f, 1.f);
+    }
+
+    unsigned int getLoadOrder() const { return loadOrder; }
+
     void playAttackAnimation(const float& deltaTime)
     {
         if (!animationComplete) {
@@ -96,10 +111,19 @@ public:
 class WeaponContainer {
 private:
 
-    std::vector<Weapon*> activeWeapons;
+    // Owned; taking one out costs O(1), and moves the last weapon into its index
+    SlotMap<Weapon*> activeWeapons;
+
+    // Scratch for restoreLoadOrder(), kept so a restart allocates nothing
+    std::vector<Weapon*> sorted;
+
+    // Weapons lying on the ground are drawn, the pool's are not
+    RenderQueue* renderQueue;
 
 public:
 
+    WeaponContainer(RenderQueue* queue = nullptr) : renderQueue(queue) {}
+
     ~WeaponContainer()
     {
         reset();
@@ -115,69 +139,65 @@ public:
     Weapon* removeByIndex(int index) 
     {
         Weapon* ptr = activeWeapons[index];
-        activeWeapons.erase(activeWeapons.begin() + index);
+        activeWeapons.eraseAt(index);
+        if (renderQueue != nullptr) renderQueue->remove(ptr->getRenderNode());
         return ptr;
     }
 
     void passWeaponsToAnotherContainer(WeaponContainer* container)
     {
         for (auto weapon : activeWeapons) {
+            if (renderQueue != nullptr) renderQueue->remove(weapon->getRenderNode());
             container->addWeapon(weapon);
         }
         activeWeapons.clear();
     }
 
+    // Puts the weapons back in the order load() created them, so the same seed hands out the same weapons
+    // however the last run took them out
+    void restoreLoadOrder()
+    {
+        sorted.assign(activeWeapons.begin(), activeWeapons.end());
+        std::sort(sorted.begin(), sorted.end(), [](const Weapon* a, const Weapon* b) { return a->getLoadOrder() < b->getLoadOrder(); });
+
+        activeWeapons.clear();
+        for (Weapon* weapon : sorted) {
+            weapon->resetPose();
+            activeWeapons.insert(weapon);
+        }
+    }
+
     unsigned int getCurrentSize() const { return activeWeapons.size(); }
 
-    void addWeapon(Weapon* wp) { activeWeapons.push_back(wp); }
+    SlotHandle addWeapon(Weapon* wp) 
+    { 
+        if (renderQueue != nullptr) renderQueue->add(wp->getRenderNode());
+        return activeWeapons.insert(wp);
+    }
 
     void update(PlayerCharacter* player);
 
-    void load(const std::string& directoryPath)
+    void load(const TextureAtlas* atlas, const std::vector<WeaponAsset>& weapons)
     {
         reset();
 
-        for (const auto& entry : fs::directory_iterator(directoryPath))
+        for (const WeaponAsset& weapon : weapons)
         {
-            if (fs::is_directory(entry.path()))
-            {
-                std::string directoryName = entry.path().filename().string();
-
-                if (directoryName == "fast") {
-                    for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
-                    {
-                        activeWeapons.push_back(new Weapon(fastWeaponDamage, fastWeaponAttackCooldown, directoryPath + directoryName + "/" + entry.path().filename().string()));
-                    }
-                }
-                else if (directoryName == "medium") {
-                    for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
-                    {
-                        activeWeapons.push_back(new Weapon(mediumWeaponDamage, mediumWeaponAttackCooldown, directoryPath + directoryName + "/" + entry.path().filename().string()));
-                    }
-                }
-                else if (directoryName == "slow") {
-                    for (const auto& entry : fs::directory_iterator(directoryPath + "/" + directoryName))
-                    {
-                        activeWeapons.push_back(new Weapon(slowWeaponDamage, slowWeaponAttackCooldown, directoryPath + directoryName + "/" + entry.path().filename().string()));
-                    }
-                }
+            if (weapon.weaponClass == fastWeapon) {
+                activeWeapons.insert(new Weapon(atlas, fastWeaponDamage, fastWeaponAttackCooldown, weapon.path, activeWeapons.size()));
+            }
+            else if (weapon.weaponClass == mediumWeapon) {
+                activeWeapons.insert(new Weapon(atlas, mediumWeaponDamage, mediumWeaponAttackCooldown, weapon.path, activeWeapons.size()));
+            }
+            else if (weapon.weaponClass == slowWeapon) {
+                activeWeapons.insert(new Weapon(atlas, slowWeaponDamage, slowWeaponAttackCooldown, weapon.path, activeWeapons.size()));
             }
         }
-
     }
 
-    Weapon* getRandomWeapon() 
+    Weapon* getRandomWeapon(RandomGenerator* random) 
     {
-        int weaponIndex = getRandomInRange(0, activeWeapons.size() - 1);
+        int weaponIndex = random->getInRange(lootStream, 0, activeWeapons.size() - 1);
         return removeByIndex(weaponIndex);
     }
-
-    std::vector<sf::Sprite> getWeaponSprites()
-    {
-        std::vector<sf::Sprite> v;
-        for (Weapon* weapon : activeWeapons) {
-            v.push_back(weapon->getSprite());
-        }
-        return v;
-    }
 };
\ No newline at end of file